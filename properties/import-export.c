@@ -86,6 +86,7 @@ setting_vpn_add_data_item_v (NMSettingVpn *setting,
 
 	g_return_if_fail (NM_IS_SETTING_VPN (setting));
 	g_return_if_fail (key && key[0]);
+	nm_assert (nmv_property_info_lookup (key));
 
 	/* let's first try with a stack allocated buffer,
 	 * it's large enough for most cases. */
@@ -123,6 +124,7 @@ setting_vpn_add_data_item (NMSettingVpn *setting,
 	g_return_if_fail (key && key[0]);
 	g_return_if_fail (value && value[0]);
 	g_return_if_fail (_is_utf8 (value));
+	nm_assert (nmv_property_info_lookup (key));
 
 	nm_setting_vpn_add_data_item (setting, key, value);
 }
@@ -137,6 +139,7 @@ setting_vpn_add_data_item_utf8safe (NMSettingVpn *setting,
 	g_return_if_fail (NM_IS_SETTING_VPN (setting));
 	g_return_if_fail (key && key[0]);
 	g_return_if_fail (value && value[0]);
+	nm_assert (nmv_property_info_lookup (key));
 
 	nm_setting_vpn_add_data_item (setting, key,
 	                              nmv_utils_str_utf8safe_escape_c (value, &s));
@@ -271,10 +274,25 @@ args_params_parse_int64 (const char **params,
 	return TRUE;
 }
 
+/* Parses a number for @key, in the range that the service accepts. */
+static gboolean
+args_params_parse_property_int64 (const char **params,
+                                  guint n_param,
+                                  const char *key,
+                                  gint64 *out,
+                                  char **out_error)
+{
+	const NMVPropertyInfo *info = nmv_property_info_lookup (key);
+
+	g_return_val_if_fail (info && info->type == G_TYPE_INT, FALSE);
+
+	return args_params_parse_int64 (params, n_param, info->int_min, info->int_max, out, out_error);
+}
+
 static gboolean
 args_params_parse_port (const char **params, guint n_param, gint64 *out, char **out_error)
 {
-	return args_params_parse_int64 (params, n_param, 1, 65535, out, out_error);
+	return args_params_parse_property_int64 (params, n_param, NM_OPENVPN_KEY_PORT, out, out_error);
 }
 
 static gboolean
@@ -406,28 +424,60 @@ _strbuf_append_c (char **buf, gsize *len, char ch)
 	*buf = &(*buf)[1];
 }
 
+/* Scratch space for args_parse_line_buf(). It is reused from one line to
+ * the next and only grows, so that parsing a whole file doesn't allocate
+ * anything per line. */
+typedef struct {
+	char *str;
+	gsize str_alloc;
+	const char **argv;
+	gsize argv_alloc;
+} ArgsParseBuf;
+
+static void
+args_parse_buf_clear (ArgsParseBuf *buf)
+{
+	nm_clear_g_free (&buf->str);
+	buf->str_alloc = 0;
+	g_clear_pointer (&buf->argv, g_free);
+	buf->argv_alloc = 0;
+}
+
+static void
+_args_parse_buf_add_arg (ArgsParseBuf *buf, gsize argc, const char *arg)
+{
+	/* keep space for the terminating NULL. */
+	if (argc + 1 >= buf->argv_alloc) {
+		buf->argv_alloc = MAX (buf->argv_alloc * 2, 16);
+		buf->argv = g_renew (const char *, buf->argv, buf->argv_alloc);
+	}
+	buf->argv[argc] = arg;
+}
+
+/* Parses @line into @buf. On success, @out_argc is the number of arguments,
+ * and buf->argv the NULL terminated arguments (if @out_argc is not zero).
+ * They stay valid until @buf is used again. */
 static gboolean
-args_parse_line (const char *line,
-                 gsize line_len,
-                 const char ***out_p,
-                 char **out_error)
+args_parse_line_buf (const char *line,
+                     gsize line_len,
+                     ArgsParseBuf *buf,
+                     gsize *out_argc,
+                     char **out_error)
 {
-	gs_unref_array GArray *index = NULL;
-	gs_free char *str_buf_orig = NULL;
 	char *str_buf;
 	gsize str_buf_len;
 	gsize i;
+	gsize argc = 0;
 	const char *line_start = line;
-	char **data;
-	char *pdata;
 
 	/* reimplement openvpn's parse_line(). */
 
 	g_return_val_if_fail (line, FALSE);
-	g_return_val_if_fail (out_p && !*out_p, FALSE);
+	g_return_val_if_fail (buf, FALSE);
+	g_return_val_if_fail (out_argc, FALSE);
 	g_return_val_if_fail (out_error && !*out_error, FALSE);
 
-	*out_p = NULL;
+	*out_argc = 0;
 
 	/* we expect no newline during the first line_len chars. */
 	for (i = 0; i < line_len; i++) {
@@ -454,18 +504,18 @@ args_parse_line (const char *line,
 	/* the maximum required buffer is @line_len+1 characters. We don't produce
 	 * *more* characters then given in the input (plus trailing '\0'). */
 	str_buf_len = line_len + 1;
-	str_buf_orig = g_malloc (str_buf_len);
-	str_buf = str_buf_orig;
-
-	index = g_array_new (FALSE, FALSE, sizeof (gsize));
+	if (str_buf_len > buf->str_alloc) {
+		buf->str_alloc = MAX (str_buf_len, buf->str_alloc * 2);
+		g_free (buf->str);
+		buf->str = g_malloc (buf->str_alloc);
+	}
+	str_buf = buf->str;
 
 	for (;;) {
 		char quote, ch0;
 		gssize word_start = line - line_start;
-		gsize index_i;
 
-		index_i = str_buf - str_buf_orig;
-		g_array_append_val (index, index_i);
+		_args_parse_buf_add_arg (buf, argc++, str_buf);
 
 		switch ((ch0 = _ch_step_1 (&line, &line_len))) {
 		case '"':
@@ -528,16 +578,41 @@ args_parse_line (const char *line,
 		}
 	}
 
-	str_buf_len = str_buf - str_buf_orig;
+	buf->argv[argc] = NULL;
+	*out_argc = argc;
+	return TRUE;
+}
+
+static gboolean
+args_parse_line (const char *line,
+                 gsize line_len,
+                 const char ***out_p,
+                 char **out_error)
+{
+	nm_auto (args_parse_buf_clear) ArgsParseBuf buf = { 0 };
+	gsize argc, str_len, i;
+	char **data;
+	char *pdata;
+
+	g_return_val_if_fail (out_p && !*out_p, FALSE);
+
+	*out_p = NULL;
+
+	if (!args_parse_line_buf (line, line_len, &buf, &argc, out_error))
+		return FALSE;
+
+	if (argc == 0)
+		return TRUE;
 
 	/* pack the result in a strv array */
-	data = g_malloc ((sizeof (const char *) * (index->len + 1)) + str_buf_len);
+	str_len = (buf.argv[argc - 1] - buf.str) + strlen (buf.argv[argc - 1]) + 1;
+	data = g_malloc ((sizeof (const char *) * (argc + 1)) + str_len);
 
-	pdata = (char *) &data[index->len + 1];
-	memcpy (pdata, str_buf_orig, str_buf_len);
+	pdata = (char *) &data[argc + 1];
+	memcpy (pdata, buf.str, str_len);
 
-	for (i = 0; i < index->len; i++)
-		data[i] = &pdata[g_array_index (index, gsize, i)];
+	for (i = 0; i < argc; i++)
+		data[i] = &pdata[buf.argv[i] - buf.str];
 	data[i] = NULL;
 
 	*out_p = (const char **) data;
@@ -575,13 +650,17 @@ args_next_line (const char **content,
 	if (l <= 0)
 		return FALSE;
 
-	*cur_line = s = *content;
+	*cur_line = *content;
 
-	while (l > 0 && !NM_IN_SET (s[0], '\0', '\n'))
-		_ch_step_1 (&s, &l);
+	s = memchr (*content, '\n', l);
+	offset = s ? (gsize) (s - *content) : l;
+	s = memchr (*content, '\0', offset);
+	if (s)
+		offset = s - *content;
 
-	offset = s - *content;
 	*cur_line_len = offset;
+	s = &(*content)[offset];
+	l -= offset;
 
 	/* cur_line_delimiter will point to a (static) string
 	 * containing the dropped character.
@@ -684,6 +763,19 @@ inline_blob_data_free (InlineBlobData *data)
 	g_slice_free (InlineBlobData, data);
 }
 
+static const char *
+inline_blob_dir (void)
+{
+	static char *dir = NULL;
+
+	if (_nmovpn_test_temp_path)
+		return _nmovpn_test_temp_path;
+
+	if (g_once_init_enter (&dir))
+		g_once_init_leave (&dir, g_build_filename (g_get_home_dir (), ".cert/nm-openvpn", NULL));
+	return dir;
+}
+
 static char *
 inline_blob_construct_path (const char *basename, const char *token)
 {
@@ -695,10 +787,7 @@ inline_blob_construct_path (const char *basename, const char *token)
 	/* Construct file name to write the data in */
 	f_filename = g_strdup_printf ("%s-%s.pem", basename, token);
 
-	if (_nmovpn_test_temp_path)
-		return g_build_filename (_nmovpn_test_temp_path, f_filename, NULL);
-
-	return g_build_filename (g_get_home_dir (), ".cert/nm-openvpn", f_filename, NULL);
+	return g_build_filename (inline_blob_dir (), f_filename, NULL);
 }
 
 static gboolean
@@ -733,10 +822,127 @@ inline_blob_mkdir_parents (const InlineBlobData *data, const char *filepath, cha
 }
 
 static gboolean
-inline_blob_write_out (const InlineBlobData *data, GError **error)
+inline_blob_write_file (const char *path, const GString *blob_data)
 {
+	static GMutex umask_lock;
 	mode_t saved_umask;
+	gboolean success;
+
+	/* the umask is per process, don't let concurrent batch imports race on it. */
+	g_mutex_lock (&umask_lock);
+	saved_umask = umask (S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+
+	/* The file is written with the default umask. Whether that is safe enough
+	 * to protect (potentally) private data or allows the openvpn service to
+	 * access the file later on is left as exercise for the user. */
+	success = g_file_set_contents (path, blob_data->str, blob_data->len, NULL);
+
+	umask (saved_umask);
+	g_mutex_unlock (&umask_lock);
+	return success;
+}
+
+static char *
+inline_blob_store_path (const char *store_dir, const char *blob, gsize blob_len)
+{
+	gs_free char *checksum = NULL;
+
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *) blob, blob_len);
+	return g_strdup_printf ("%s/%s.pem", store_dir, checksum);
+}
+
+/* Returns the stored blob that @path links to, if any. */
+static char *
+inline_blob_store_path_of (const char *store_dir, const char *path)
+{
+	gs_free char *contents = NULL;
+	gs_free char *store_path = NULL;
+	gsize len;
+	struct stat st_path, st_store;
 
+	if (   lstat (path, &st_path) < 0
+	    || !S_ISREG (st_path.st_mode)
+	    || st_path.st_nlink < 2)
+		return NULL;
+
+	if (!g_file_get_contents (path, &contents, &len, NULL))
+		return NULL;
+
+	store_path = inline_blob_store_path (store_dir, contents, len);
+	if (   lstat (store_path, &st_store) < 0
+	    || st_store.st_dev != st_path.st_dev
+	    || st_store.st_ino != st_path.st_ino)
+		return NULL;
+
+	return g_steal_pointer (&store_path);
+}
+
+/* The blobs are stored once by their SHA-256 in the "blobs" directory,
+ * the file of each connection is a hard link to it. That way, a CA shared
+ * by many profiles is on disk only once and the link count of the stored
+ * blob tells how many connections still use it. When a re-import replaces
+ * the file of a connection, the blob it linked to is removed from the
+ * store if no other connection uses it.
+ *
+ * Since the files are hard links, editing the file of one connection in
+ * place changes it for every connection sharing that blob. Tools that
+ * write a new file and rename it over the old one, like the importer
+ * does, only affect the one connection.
+ *
+ * Returns: %TRUE if data->path links to the stored blob, %FALSE if that
+ *   isn't possible (e.g. hard links are not supported). */
+static gboolean
+inline_blob_link_to_store (const InlineBlobData *data)
+{
+	gs_free char *store_dir = NULL;
+	gs_free char *store_path = NULL;
+	gs_free char *old_store_path = NULL;
+	gs_free char *tmp_path = NULL;
+	struct stat st_store, st_path;
+
+	store_dir = g_build_filename (inline_blob_dir (), "blobs", NULL);
+	if (mkdir (store_dir, 0700) < 0 && errno != EEXIST)
+		return FALSE;
+
+	store_path = inline_blob_store_path (store_dir, data->blob_data->str, data->blob_data->len);
+
+	if (stat (store_path, &st_store) < 0) {
+		if (!inline_blob_write_file (store_path, data->blob_data))
+			return FALSE;
+		if (stat (store_path, &st_store) < 0)
+			return FALSE;
+	} else if (   lstat (data->path, &st_path) == 0
+	           && st_path.st_dev == st_store.st_dev
+	           && st_path.st_ino == st_store.st_ino) {
+		/* re-import of the same blob, nothing to write. */
+		return TRUE;
+	}
+
+	old_store_path = inline_blob_store_path_of (store_dir, data->path);
+
+	/* link under a temporary name and rename it over the target, so
+	 * that the file is never missing or partially written. */
+	tmp_path = g_strdup_printf ("%s.%08x", data->path, g_random_int ());
+	if (link (store_path, tmp_path) < 0)
+		return FALSE;
+	if (rename (tmp_path, data->path) < 0) {
+		unlink (tmp_path);
+		return FALSE;
+	}
+
+	/* drop the blob the connection used before, unless it is still shared. */
+	if (   old_store_path
+	    && !nm_streq (old_store_path, store_path)
+	    && lstat (old_store_path, &st_store) == 0
+	    && st_store.st_nlink == 1)
+		unlink (old_store_path);
+
+	return TRUE;
+}
+
+static gboolean
+inline_blob_write_out (const InlineBlobData *data, GError **error)
+{
 	if (!_nmovpn_test_temp_path) {
 		gs_free char *err_msg = NULL;
 
@@ -753,12 +959,11 @@ inline_blob_write_out (const InlineBlobData *data, GError **error)
 		}
 	}
 
-	saved_umask = umask (S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+	if (inline_blob_link_to_store (data))
+		return TRUE;
 
-	/* The file is written with the default umask. Whether that is safe enough
-	 * to protect (potentally) private data or allows the openvpn service to
-	 * access the file later on is left as exercise for the user. */
-	if (!g_file_set_contents (data->path, data->blob_data->str, data->blob_data->len, NULL)) {
+	/* fall back to a plain copy. */
+	if (!inline_blob_write_file (data->path, data->blob_data)) {
 		g_set_error (error,
 		             NMV_EDITOR_PLUGIN_ERROR,
 		             NMV_EDITOR_PLUGIN_ERROR_FAILED,
@@ -766,18 +971,196 @@ inline_blob_write_out (const InlineBlobData *data, GError **error)
 		             data->token,
 		             (long) data->token_start_line,
 		             data->path);
-		umask (saved_umask);
 		return FALSE;
 	}
 
-	umask (saved_umask);
 	return TRUE;
 }
 
+/**
+ * do_import_gc_blobs:
+ *
+ * Removes the stored inline blobs that are no longer linked by the file
+ * of any connection, e.g. because the file was deleted. do_import_batch()
+ * calls it once all files are imported. Blobs that a re-import replaces
+ * are already removed on import.
+ */
+void
+do_import_gc_blobs (void)
+{
+	gs_free char *store_dir = NULL;
+	GDir *dir;
+	const char *name;
+
+	store_dir = g_build_filename (inline_blob_dir (), "blobs", NULL);
+	dir = g_dir_open (store_dir, 0, NULL);
+	if (!dir)
+		return;
+
+	while ((name = g_dir_read_name (dir))) {
+		gs_free char *path = NULL;
+		struct stat st;
+
+		if (!g_str_has_suffix (name, ".pem"))
+			continue;
+
+		path = g_build_filename (store_dir, name, NULL);
+		if (   lstat (path, &st) == 0
+		    && S_ISREG (st.st_mode)
+		    && st.st_nlink == 1)
+			unlink (path);
+	}
+	g_dir_close (dir);
+}
+
 /*****************************************************************************/
 
-NMConnection *
-do_import (const char *path, const char *contents, gsize contents_len, GError **error)
+/* The directives that do_import() understands, with the number of arguments
+ * they accept and, if the directive sets a single key of the VPN setting,
+ * that key. */
+
+typedef enum {
+	IMPORT_TAG_UNKNOWN = 0,
+	IMPORT_TAG_CLIENT,
+	IMPORT_TAG_TLS_CLIENT,
+	IMPORT_TAG_KEY_DIRECTION,
+	IMPORT_TAG_DEV,
+	IMPORT_TAG_DEV_TYPE,
+	IMPORT_TAG_PROTO,
+	IMPORT_TAG_MSSFIX,
+	IMPORT_TAG_NS_CERT_TYPE,
+	IMPORT_TAG_TUN_MTU,
+	IMPORT_TAG_FRAGMENT,
+	IMPORT_TAG_COMP_LZO,
+	IMPORT_TAG_FLOAT,
+	IMPORT_TAG_RENEG_SEC,
+	IMPORT_TAG_MAX_ROUTES,
+	IMPORT_TAG_HTTP_PROXY_RETRY,
+	IMPORT_TAG_SOCKS_PROXY_RETRY,
+	IMPORT_TAG_HTTP_PROXY,
+	IMPORT_TAG_SOCKS_PROXY,
+	IMPORT_TAG_REMOTE,
+	IMPORT_TAG_REMOTE_RANDOM,
+	IMPORT_TAG_TUN_IPV6,
+	IMPORT_TAG_PORT,
+	IMPORT_TAG_RPORT,
+	IMPORT_TAG_PING,
+	IMPORT_TAG_PING_EXIT,
+	IMPORT_TAG_PING_RESTART,
+	IMPORT_TAG_PKCS12,
+	IMPORT_TAG_CA,
+	IMPORT_TAG_CERT,
+	IMPORT_TAG_KEY,
+	IMPORT_TAG_SECRET,
+	IMPORT_TAG_TLS_AUTH,
+	IMPORT_TAG_CIPHER,
+	IMPORT_TAG_TLS_CIPHER,
+	IMPORT_TAG_KEEPALIVE,
+	IMPORT_TAG_KEYSIZE,
+	IMPORT_TAG_TLS_REMOTE,
+	IMPORT_TAG_VERIFY_X509_NAME,
+	IMPORT_TAG_REMOTE_CERT_TLS,
+	IMPORT_TAG_IFCONFIG,
+	IMPORT_TAG_AUTH_USER_PASS,
+	IMPORT_TAG_AUTH,
+	IMPORT_TAG_ROUTE,
+} ImportTag;
+
+typedef struct {
+	const char *name;
+	ImportTag tag;
+	guint8 nargs_min;
+	guint8 nargs_max;
+	const char *key;
+} ImportTagInfo;
+
+static const ImportTagInfo import_tags[] = {
+	{ NMV_OVPN_TAG_CLIENT,             IMPORT_TAG_CLIENT,            0, 0, NULL },
+	{ NMV_OVPN_TAG_TLS_CLIENT,         IMPORT_TAG_TLS_CLIENT,        0, 0, NULL },
+	{ NMV_OVPN_TAG_KEY_DIRECTION,      IMPORT_TAG_KEY_DIRECTION,     1, 1, NULL },
+	{ NMV_OVPN_TAG_DEV,                IMPORT_TAG_DEV,               1, 1, NM_OPENVPN_KEY_DEV },
+	{ NMV_OVPN_TAG_DEV_TYPE,           IMPORT_TAG_DEV_TYPE,          1, 1, NM_OPENVPN_KEY_DEV_TYPE },
+	{ NMV_OVPN_TAG_PROTO,              IMPORT_TAG_PROTO,             1, 1, NM_OPENVPN_KEY_PROTO_TCP },
+	{ NMV_OVPN_TAG_MSSFIX,             IMPORT_TAG_MSSFIX,            0, 1, NM_OPENVPN_KEY_MSSFIX },
+	{ NMV_OVPN_TAG_NS_CERT_TYPE,       IMPORT_TAG_NS_CERT_TYPE,      1, 1, NM_OPENVPN_KEY_NS_CERT_TYPE },
+	{ NMV_OVPN_TAG_TUN_MTU,            IMPORT_TAG_TUN_MTU,           1, 1, NM_OPENVPN_KEY_TUNNEL_MTU },
+	{ NMV_OVPN_TAG_FRAGMENT,           IMPORT_TAG_FRAGMENT,          1, 1, NM_OPENVPN_KEY_FRAGMENT_SIZE },
+	{ NMV_OVPN_TAG_COMP_LZO,           IMPORT_TAG_COMP_LZO,          0, 1, NM_OPENVPN_KEY_COMP_LZO },
+	{ NMV_OVPN_TAG_FLOAT,              IMPORT_TAG_FLOAT,             0, 0, NM_OPENVPN_KEY_FLOAT },
+	{ NMV_OVPN_TAG_RENEG_SEC,          IMPORT_TAG_RENEG_SEC,         1, 1, NM_OPENVPN_KEY_RENEG_SECONDS },
+	{ NMV_OVPN_TAG_MAX_ROUTES,         IMPORT_TAG_MAX_ROUTES,        1, 1, NM_OPENVPN_KEY_MAX_ROUTES },
+	{ NMV_OVPN_TAG_HTTP_PROXY_RETRY,   IMPORT_TAG_HTTP_PROXY_RETRY,  0, 0, NM_OPENVPN_KEY_PROXY_RETRY },
+	{ NMV_OVPN_TAG_SOCKS_PROXY_RETRY,  IMPORT_TAG_SOCKS_PROXY_RETRY, 0, 0, NM_OPENVPN_KEY_PROXY_RETRY },
+	{ NMV_OVPN_TAG_HTTP_PROXY,         IMPORT_TAG_HTTP_PROXY,        2, 4, NULL },
+	{ NMV_OVPN_TAG_SOCKS_PROXY,        IMPORT_TAG_SOCKS_PROXY,       1, 3, NULL },
+	{ NMV_OVPN_TAG_REMOTE,             IMPORT_TAG_REMOTE,            1, 3, NM_OPENVPN_KEY_REMOTE },
+	{ NMV_OVPN_TAG_REMOTE_RANDOM,      IMPORT_TAG_REMOTE_RANDOM,     0, 0, NM_OPENVPN_KEY_REMOTE_RANDOM },
+	{ NMV_OVPN_TAG_TUN_IPV6,           IMPORT_TAG_TUN_IPV6,          0, 0, NM_OPENVPN_KEY_TUN_IPV6 },
+	{ NMV_OVPN_TAG_PORT,               IMPORT_TAG_PORT,              1, 1, NM_OPENVPN_KEY_PORT },
+	{ NMV_OVPN_TAG_RPORT,              IMPORT_TAG_RPORT,             1, 1, NM_OPENVPN_KEY_PORT },
+	{ NMV_OVPN_TAG_PING,               IMPORT_TAG_PING,              1, 1, NM_OPENVPN_KEY_PING },
+	{ NMV_OVPN_TAG_PING_EXIT,          IMPORT_TAG_PING_EXIT,         1, 1, NM_OPENVPN_KEY_PING_EXIT },
+	{ NMV_OVPN_TAG_PING_RESTART,       IMPORT_TAG_PING_RESTART,      1, 1, NM_OPENVPN_KEY_PING_RESTART },
+	{ NMV_OVPN_TAG_PKCS12,             IMPORT_TAG_PKCS12,            1, 1, NULL },
+	{ NMV_OVPN_TAG_CA,                 IMPORT_TAG_CA,                1, 1, NM_OPENVPN_KEY_CA },
+	{ NMV_OVPN_TAG_CERT,               IMPORT_TAG_CERT,              1, 1, NM_OPENVPN_KEY_CERT },
+	{ NMV_OVPN_TAG_KEY,                IMPORT_TAG_KEY,               1, 1, NM_OPENVPN_KEY_KEY },
+	{ NMV_OVPN_TAG_SECRET,             IMPORT_TAG_SECRET,            1, 2, NM_OPENVPN_KEY_STATIC_KEY },
+	{ NMV_OVPN_TAG_TLS_AUTH,           IMPORT_TAG_TLS_AUTH,          1, 2, NM_OPENVPN_KEY_TA },
+	{ NMV_OVPN_TAG_CIPHER,             IMPORT_TAG_CIPHER,            1, 1, NM_OPENVPN_KEY_CIPHER },
+	{ NMV_OVPN_TAG_TLS_CIPHER,         IMPORT_TAG_TLS_CIPHER,        1, 1, NM_OPENVPN_KEY_TLS_CIPHER },
+	{ NMV_OVPN_TAG_KEEPALIVE,          IMPORT_TAG_KEEPALIVE,         2, 2, NULL },
+	{ NMV_OVPN_TAG_KEYSIZE,            IMPORT_TAG_KEYSIZE,           1, 1, NM_OPENVPN_KEY_KEYSIZE },
+	{ NMV_OVPN_TAG_TLS_REMOTE,         IMPORT_TAG_TLS_REMOTE,        1, 1, NM_OPENVPN_KEY_TLS_REMOTE },
+	{ NMV_OVPN_TAG_VERIFY_X509_NAME,   IMPORT_TAG_VERIFY_X509_NAME,  1, 2, NM_OPENVPN_KEY_VERIFY_X509_NAME },
+	{ NMV_OVPN_TAG_REMOTE_CERT_TLS,    IMPORT_TAG_REMOTE_CERT_TLS,   1, 1, NM_OPENVPN_KEY_REMOTE_CERT_TLS },
+	{ NMV_OVPN_TAG_IFCONFIG,           IMPORT_TAG_IFCONFIG,          2, 2, NULL },
+	{ NMV_OVPN_TAG_AUTH_USER_PASS,     IMPORT_TAG_AUTH_USER_PASS,    0, 1, NULL },
+	{ NMV_OVPN_TAG_AUTH,               IMPORT_TAG_AUTH,              1, 1, NM_OPENVPN_KEY_AUTH },
+	{ NMV_OVPN_TAG_ROUTE,              IMPORT_TAG_ROUTE,             1, 4, NULL },
+};
+
+static const ImportTagInfo *
+import_tag_lookup (const char *name)
+{
+	static GHashTable *table = NULL;
+
+	if (g_once_init_enter (&table)) {
+		GHashTable *t;
+		guint i;
+
+		t = g_hash_table_new (g_str_hash, g_str_equal);
+		for (i = 0; i < G_N_ELEMENTS (import_tags); i++)
+			g_hash_table_insert (t, (gpointer) import_tags[i].name, (gpointer) &import_tags[i]);
+		g_once_init_leave (&table, t);
+	}
+
+	return g_hash_table_lookup (table, name);
+}
+
+/*****************************************************************************/
+
+/* The name of the connection: the file name without extension. */
+static char *
+_import_basename (const char *path)
+{
+	char *basename, *tmp;
+
+	basename = g_path_get_basename (path);
+	tmp = strrchr (basename, '.');
+	if (tmp)
+		*tmp = '\0';
+	return basename;
+}
+
+/* @blob_prefix: (allow-none): how to name the files of the inline blobs,
+ *   instead of after the connection. */
+static NMConnection *
+_do_import (const char *path,
+            const char *contents,
+            gsize contents_len,
+            const char *blob_prefix,
+            GError **error)
 {
 	gs_unref_object NMConnection *connection_free = NULL;
 	NMConnection *connection;
@@ -796,7 +1179,9 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 	const char *last_seen_key_direction = NULL;
 	gboolean have_certs, have_ca;
 	GSList *inline_blobs = NULL, *sl_iter;
+	nm_auto (args_parse_buf_clear) ArgsParseBuf parse_buf = { 0 };
 
+	g_return_val_if_fail (contents || !contents_len, NULL);
 	g_return_val_if_fail (!error || !*error, NULL);
 
 	connection = nm_simple_connection_new ();
@@ -822,13 +1207,10 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 		g_free (tmp2);
 	}
 
-	basename = g_path_get_basename (path);
-	tmp = strrchr (basename, '.');
-	if (tmp)
-		*tmp = '\0';
+	basename = _import_basename (path);
 	g_object_set (s_con, NM_SETTING_CONNECTION_ID, basename, NULL);
 
-	if (strncmp (contents, "\xEF\xBB\xBF", 3) == 0) {
+	if (contents_len >= 3 && memcmp (contents, "\xEF\xBB\xBF", 3) == 0) {
 		/* skip over UTF-8 BOM */
 		contents += 3;
 		contents_len -= 3;
@@ -840,19 +1222,22 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 	                       &cur_line,
 	                       &cur_line_len,
 	                       &cur_line_delimiter)) {
-		gs_free const char **params = NULL;
+		const char **params;
+		gsize n_params;
+		const ImportTagInfo *tag_info;
 		char *line_error = NULL;
 		gint64 v_int64;
 
 		contents_cur_line++;
 
-		if (!args_parse_line (cur_line, cur_line_len, &params, &line_error))
+		if (!args_parse_line_buf (cur_line, cur_line_len, &parse_buf, &n_params, &line_error))
 			goto handle_line_error;
 
-		if (!params) {
+		if (n_params == 0) {
 			/* empty line of comments. */
 			continue;
 		}
+		params = parse_buf.argv;
 
 		g_assert (params[0]);
 
@@ -860,44 +1245,37 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 		if (g_str_has_prefix (params[0], "--"))
 			params[0] = &params[0][2];
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_CLIENT, NMV_OVPN_TAG_TLS_CLIENT)) {
-			if (!args_params_check_nargs_n (params, 0, &line_error))
-				goto handle_line_error;
+		tag_info = import_tag_lookup (params[0]);
+		if (   tag_info
+		    && !args_params_check_nargs_minmax (params, tag_info->nargs_min, tag_info->nargs_max, &line_error))
+			goto handle_line_error;
+
+		switch (tag_info ? tag_info->tag : IMPORT_TAG_UNKNOWN) {
+		case IMPORT_TAG_CLIENT:
+		case IMPORT_TAG_TLS_CLIENT:
 			have_client = TRUE;
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_KEY_DIRECTION)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_KEY_DIRECTION:
 			if (!args_params_parse_key_direction (params, 1, &last_seen_key_direction, &line_error))
 				goto handle_line_error;
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_DEV)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_DEV:
 			if (!args_params_check_arg_nonempty (params, 1, NULL, &line_error))
 				goto handle_line_error;
 			setting_vpn_add_data_item_utf8safe (s_vpn, NM_OPENVPN_KEY_DEV, params[1]);
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_DEV_TYPE)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_DEV_TYPE:
 			if (!NM_IN_STRSET (params[1], "tun", "tap")) {
 				line_error = args_params_error_message_invalid_arg (params, 1);
 				goto handle_line_error;
 			}
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_DEV_TYPE, params[1]);
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_PROTO)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_PROTO:
 			/* Valid parameters are "udp", "tcp-client" and "tcp-server".
 			 * 'tcp' isn't technically valid, but it used to be accepted so
 			 * we'll handle it here anyway.
@@ -911,11 +1289,8 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 				goto handle_line_error;
 			}
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_MSSFIX)) {
-			if (!args_params_check_nargs_minmax (params, 0, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_MSSFIX:
 			if (params[1]) {
 				if (!args_params_parse_int64 (params, 1, 1, G_MAXINT32, &v_int64, &line_error))
 					goto handle_line_error;
@@ -923,43 +1298,33 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 			} else
 				setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_MSSFIX, "yes");
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_NS_CERT_TYPE)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_NS_CERT_TYPE:
 			if (!NM_IN_STRSET (params[1], NM_OPENVPN_NS_CERT_TYPE_CLIENT, NM_OPENVPN_NS_CERT_TYPE_SERVER)) {
 				line_error = g_strdup_printf (_("invalid option"));
 				goto handle_line_error;
 			}
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_NS_CERT_TYPE, params[1]);
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_TUN_MTU)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
+		case IMPORT_TAG_TUN_MTU:
+		case IMPORT_TAG_FRAGMENT:
+		case IMPORT_TAG_RENEG_SEC:
+		case IMPORT_TAG_MAX_ROUTES:
+		case IMPORT_TAG_PORT:
+		case IMPORT_TAG_RPORT:
+		case IMPORT_TAG_PING:
+		case IMPORT_TAG_PING_EXIT:
+		case IMPORT_TAG_PING_RESTART:
+		case IMPORT_TAG_KEYSIZE:
+			if (!args_params_parse_property_int64 (params, 1, tag_info->key, &v_int64, &line_error))
 				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 1, 0, 0xffff, &v_int64, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_TUNNEL_MTU, v_int64);
+			setting_vpn_add_data_item_int64 (s_vpn, tag_info->key, v_int64);
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_FRAGMENT)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 1, 0, 0xffff, &v_int64, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_FRAGMENT_SIZE, v_int64);
-			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_COMP_LZO)) {
+		case IMPORT_TAG_COMP_LZO: {
 			const char *v;
 
-			if (!args_params_check_nargs_minmax (params, 0, 1, &line_error))
-				goto handle_line_error;
-
 			v = params[1] ?: "adaptive";
 
 			if (nm_streq (v, "no")) {
@@ -975,53 +1340,26 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 			continue;
 		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_FLOAT)) {
-			if (!args_params_check_nargs_n (params, 0, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_FLOAT:
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_FLOAT, "yes");
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_RENEG_SEC)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 1, 0, G_MAXINT, &v_int64, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_RENEG_SECONDS, v_int64);
-			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_MAX_ROUTES)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 1, 0, 100000000, &v_int64, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_MAX_ROUTES, v_int64);
-			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_HTTP_PROXY_RETRY, NMV_OVPN_TAG_SOCKS_PROXY_RETRY)) {
-			if (!args_params_check_nargs_n (params, 0, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_HTTP_PROXY_RETRY:
+		case IMPORT_TAG_SOCKS_PROXY_RETRY:
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_PROXY_RETRY, "yes");
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_HTTP_PROXY, NMV_OVPN_TAG_SOCKS_PROXY)) {
+		case IMPORT_TAG_HTTP_PROXY:
+		case IMPORT_TAG_SOCKS_PROXY: {
 			const char *proxy_type = NULL;
 			gint64 port = 0;
 			gs_free char *user = NULL;
 			gs_free char *pass = NULL;
 
-			if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_HTTP_PROXY)) {
+			if (tag_info->tag == IMPORT_TAG_HTTP_PROXY)
 				proxy_type = "http";
-				if (!args_params_check_nargs_minmax (params, 2, 4, &line_error))
-					goto handle_line_error;
-			} else {
+			else
 				proxy_type = "socks";
-				if (!args_params_check_nargs_minmax (params, 1, 3, &line_error))
-					goto handle_line_error;
-			}
 
 			if (!args_params_check_arg_utf8 (params, 1, "service", &line_error))
 				goto handle_line_error;
@@ -1053,14 +1391,11 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 			continue;
 		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_REMOTE)) {
+		case IMPORT_TAG_REMOTE: {
 			const char *prev;
 			GString *new_remote;
 			int port = -1;
 
-			if (!args_params_check_nargs_minmax (params, 1, 3, &line_error))
-				goto handle_line_error;
-
 			if (!args_params_check_arg_utf8 (params, 1, NULL, &line_error))
 				goto handle_line_error;
 			if (strchr (params[1], ' ')) {
@@ -1107,67 +1442,24 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 			continue;
 		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_REMOTE_RANDOM)) {
-			if (!args_params_check_nargs_n (params, 0, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_REMOTE_RANDOM:
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_REMOTE_RANDOM, "yes");
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_TUN_IPV6)) {
-			if (!args_params_check_nargs_n (params, 0, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_TUN_IPV6:
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_TUN_IPV6, "yes");
 			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_PORT, NMV_OVPN_TAG_RPORT)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_parse_port (params, 1, &v_int64, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_PORT, v_int64);
-			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_PING, NMV_OVPN_TAG_PING_EXIT, NMV_OVPN_TAG_PING_RESTART)) {
-			const char *key = NULL;
-
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 1, 0, G_MAXINT, &v_int64, &line_error))
-				goto handle_line_error;
-
-			if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_PING))
-				key = NM_OPENVPN_KEY_PING;
-			else if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_PING_EXIT))
-				key = NM_OPENVPN_KEY_PING_EXIT;
-			else if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_PING_RESTART))
-				key = NM_OPENVPN_KEY_PING_RESTART;
-
-			setting_vpn_add_data_item_int64 (s_vpn, key, v_int64);
-			continue;
-		}
 
-		if (NM_IN_STRSET (params[0],
-		                 NMV_OVPN_TAG_PKCS12,
-		                 NMV_OVPN_TAG_CA,
-		                 NMV_OVPN_TAG_CERT,
-		                 NMV_OVPN_TAG_KEY,
-		                 NMV_OVPN_TAG_SECRET,
-		                 NMV_OVPN_TAG_TLS_AUTH)) {
+		case IMPORT_TAG_PKCS12:
+		case IMPORT_TAG_CA:
+		case IMPORT_TAG_CERT:
+		case IMPORT_TAG_KEY:
+		case IMPORT_TAG_SECRET:
+		case IMPORT_TAG_TLS_AUTH: {
 			const char *file;
 			gs_free char *file_free = NULL;
-			gboolean can_have_direction;
 			const char *s_direction = NULL;
 
-			can_have_direction = NM_IN_STRSET (params[0],
-			                                  NMV_OVPN_TAG_SECRET,
-			                                  NMV_OVPN_TAG_TLS_AUTH);
-
-			if (!args_params_check_nargs_minmax (params, 1, can_have_direction ? 2 : 1, &line_error))
-				goto handle_line_error;
-
 			if (!args_params_check_arg_nonempty (params, 1, NULL, &line_error))
 				goto handle_line_error;
 			file = params[1];
@@ -1181,86 +1473,50 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 			if (!g_path_is_absolute (file))
 				file = file_free = g_build_filename (default_path, file, NULL);
 
-			if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_PKCS12)) {
+			if (tag_info->tag == IMPORT_TAG_PKCS12) {
 				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_CA, file);
 				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_CERT, file);
 				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_KEY, file);
-			} else if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_CA))
-				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_CA, file);
-			else if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_CERT))
-				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_CERT, file);
-			else if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_KEY))
-				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_KEY, file);
-			else if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_SECRET)) {
-				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_STATIC_KEY, file);
+				continue;
+			}
+
+			setting_vpn_add_data_item_path (s_vpn, tag_info->key, file);
+			if (tag_info->tag == IMPORT_TAG_SECRET) {
 				if (s_direction)
 					setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_STATIC_KEY_DIRECTION, s_direction);
 				have_sk = TRUE;
-			} else if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_TLS_AUTH)) {
-				setting_vpn_add_data_item_path (s_vpn, NM_OPENVPN_KEY_TA, file);
+			} else if (tag_info->tag == IMPORT_TAG_TLS_AUTH) {
 				if (s_direction)
 					setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_TA_DIR, s_direction);
-			} else
-				g_assert_not_reached ();
-			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_CIPHER)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_check_arg_utf8 (params, 1, NULL, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_CIPHER, params[1]);
+			}
 			continue;
 		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_TLS_CIPHER)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_CIPHER:
+		case IMPORT_TAG_TLS_CIPHER:
+		case IMPORT_TAG_TLS_REMOTE:
+		case IMPORT_TAG_AUTH:
 			if (!args_params_check_arg_utf8 (params, 1, NULL, &line_error))
 				goto handle_line_error;
-			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_TLS_CIPHER, params[1]);
+			setting_vpn_add_data_item (s_vpn, tag_info->key, params[1]);
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_KEEPALIVE)) {
+		case IMPORT_TAG_KEEPALIVE: {
 			gint64 v2;
 
-			if (!args_params_check_nargs_n (params, 2, &line_error))
+			if (!args_params_parse_property_int64 (params, 1, NM_OPENVPN_KEY_PING, &v_int64, &line_error))
 				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 1, 0, G_MAXINT, &v_int64, &line_error))
-				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 2, 0, G_MAXINT, &v2, &line_error))
+			if (!args_params_parse_property_int64 (params, 2, NM_OPENVPN_KEY_PING_RESTART, &v2, &line_error))
 				goto handle_line_error;
 			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_PING, v_int64);
 			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_PING_RESTART, v2);
 			continue;
 		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_KEYSIZE)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_parse_int64 (params, 1, 1, 65535, &v_int64, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item_int64 (s_vpn, NM_OPENVPN_KEY_KEYSIZE, v_int64);
-			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_TLS_REMOTE)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_check_arg_utf8 (params, 1, NULL, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_TLS_REMOTE, params[1]);
-			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_VERIFY_X509_NAME)) {
+		case IMPORT_TAG_VERIFY_X509_NAME: {
 			const char *type = "subject";
 			gs_free char *item = NULL;
 
-			if (!args_params_check_nargs_minmax (params, 1, 2, &line_error))
-				goto handle_line_error;
 			if (!args_params_check_arg_utf8 (params, 1, NULL, &line_error))
 				goto handle_line_error;
 
@@ -1281,20 +1537,15 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 			continue;
 		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_REMOTE_CERT_TLS)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_REMOTE_CERT_TLS:
 			if (!NM_IN_STRSET (params[1], NM_OPENVPN_REM_CERT_TLS_CLIENT, NM_OPENVPN_REM_CERT_TLS_SERVER)) {
 				line_error = g_strdup_printf (_("invalid option"));
 				goto handle_line_error;
 			}
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_REMOTE_CERT_TLS, params[1]);
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_IFCONFIG)) {
-			if (!args_params_check_nargs_n (params, 2, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_IFCONFIG:
 			if (!args_params_check_arg_utf8 (params, 1, "local", &line_error))
 				goto handle_line_error;
 			if (!args_params_check_arg_utf8 (params, 2, "remote", &line_error))
@@ -1302,33 +1553,17 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_LOCAL_IP, params[1]);
 			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_REMOTE_IP, params[2]);
 			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_AUTH_USER_PASS)) {
-			if (!args_params_check_nargs_minmax (params, 0, 1, &line_error))
-				goto handle_line_error;
+		case IMPORT_TAG_AUTH_USER_PASS:
 			have_pass = TRUE;
 			continue;
-		}
-
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_AUTH)) {
-			if (!args_params_check_nargs_n (params, 1, &line_error))
-				goto handle_line_error;
-			if (!args_params_check_arg_utf8 (params, 1, NULL, &line_error))
-				goto handle_line_error;
-			setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_AUTH, params[1]);
-			continue;
-		}
 
-		if (NM_IN_STRSET (params[0], NMV_OVPN_TAG_ROUTE)) {
+		case IMPORT_TAG_ROUTE: {
 			in_addr_t network;
 			in_addr_t gateway = 0;
 			guint32 prefix = 32;
 			gint64 metric = -1;
 
-			if (!args_params_check_nargs_minmax (params, 1, 4, &line_error))
-				goto handle_line_error;
-
 			if (!args_params_parse_ip4 (params, 1, TRUE, &network, &line_error))
 				goto handle_line_error;
 
@@ -1380,6 +1615,11 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 				nm_ip_route_unref (route);
 #endif
 			}
+			continue;
+		}
+
+		default:
+			break;
 		}
 
 		if (params[0][0] == '<' && params[0][strlen (params[0]) - 1] == '>') {
@@ -1427,7 +1667,8 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 				/* skip over trailing space like openvpn does. */
 				_ch_skip_over_leading_whitespace (&cur_line, &cur_line_len);
 
-				if (!strncmp (cur_line, end_token, end_token_len)) {
+				if (   cur_line_len >= end_token_len
+				    && !memcmp (cur_line, end_token, end_token_len)) {
 					end_token_len = 0;
 					break;
 				}
@@ -1453,7 +1694,7 @@ do_import (const char *path, const char *contents, gsize contents_len, GError **
 				}
 			}
 
-			f_path = inline_blob_construct_path (basename, token);
+			f_path = inline_blob_construct_path (blob_prefix ?: basename, token);
 
 			inline_blob_data = g_slice_new (InlineBlobData);
 			inline_blob_data->blob_data = blob_data;
@@ -1589,6 +1830,204 @@ out_error:
 	return NULL;
 }
 
+static gboolean
+_import_has_known_extension (const char *path)
+{
+	const char *ext;
+
+	ext = strrchr (path, '.');
+	return    ext
+	       && (   g_str_has_suffix (ext, ".ovpn")
+	           || g_str_has_suffix (ext, ".conf")
+	           || g_str_has_suffix (ext, ".cnf")
+	           || g_str_has_suffix (ext, ".ovpntest"));   /* Special extension for testcases */
+}
+
+NMConnection *
+do_import (const char *path, const char *contents, gsize contents_len, GError **error)
+{
+	return _do_import (path, contents, contents_len, NULL, error);
+}
+
+static NMConnection *
+_do_import_file (const char *path, const char *blob_prefix, GError **error)
+{
+	GMappedFile *file;
+	const char *contents;
+	NMConnection *connection;
+
+	if (!_import_has_known_extension (path)) {
+		g_set_error_literal (error,
+		                     NMV_EDITOR_PLUGIN_ERROR,
+		                     NMV_EDITOR_PLUGIN_ERROR_FILE_NOT_VPN,
+		                     _("unknown OpenVPN file extension"));
+		return NULL;
+	}
+
+	/* Map the file instead of reading it. Configurations with large inline
+	 * certificate bundles are then parsed in place. */
+	file = g_mapped_file_new (path, FALSE, error);
+	if (!file)
+		return NULL;
+
+	contents = g_mapped_file_get_contents (file);
+	connection = _do_import (path, contents ?: "", g_mapped_file_get_length (file), blob_prefix, error);
+	g_mapped_file_unref (file);
+	return connection;
+}
+
+NMConnection *
+do_import_file (const char *path, GError **error)
+{
+	return _do_import_file (path, NULL, error);
+}
+
+/*****************************************************************************/
+
+static ImportBatchResult *
+import_batch_result_new (char *path)
+{
+	ImportBatchResult *result;
+
+	result = g_slice_new0 (ImportBatchResult);
+	result->path = path;
+	return result;
+}
+
+static void
+import_batch_result_free (ImportBatchResult *result)
+{
+	g_free (result->path);
+	g_clear_object (&result->connection);
+	g_clear_error (&result->error);
+	g_slice_free (ImportBatchResult, result);
+}
+
+static int
+_strcmp_p (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*((const char **) a), *((const char **) b));
+}
+
+static void
+_import_batch_add_path (GPtrArray *results, const char *path)
+{
+	ImportBatchResult *result;
+	GPtrArray *names;
+	GDir *dir;
+	const char *name;
+	guint i;
+
+	if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
+		g_ptr_array_add (results, import_batch_result_new (g_strdup (path)));
+		return;
+	}
+
+	result = import_batch_result_new (g_strdup (path));
+	dir = g_dir_open (path, 0, &result->error);
+	if (!dir) {
+		g_ptr_array_add (results, result);
+		return;
+	}
+	import_batch_result_free (result);
+
+	/* Only pick up what looks like a configuration, the directory likely
+	 * contains the referenced certificates too. */
+	names = g_ptr_array_new ();
+	while ((name = g_dir_read_name (dir))) {
+		if (_import_has_known_extension (name))
+			g_ptr_array_add (names, g_build_filename (path, name, NULL));
+	}
+	g_dir_close (dir);
+
+	g_ptr_array_sort (names, _strcmp_p);
+	for (i = 0; i < names->len; i++)
+		g_ptr_array_add (results, import_batch_result_new (names->pdata[i]));
+	g_ptr_array_free (names, TRUE);
+}
+
+static void
+_import_batch_thread (gpointer data, gpointer user_data)
+{
+	ImportBatchResult *result = data;
+	GHashTable *basename_counts = user_data;
+	gs_free char *basename = NULL;
+	gs_free char *blob_prefix = NULL;
+
+	/* the blob files are named after the connection. Files of the same
+	 * name from different directories, like one client.ovpn per user,
+	 * must not overwrite each other's keys, so tell them apart by a
+	 * hash of their path. */
+	basename = _import_basename (result->path);
+	if (GPOINTER_TO_UINT (g_hash_table_lookup (basename_counts, basename)) > 1) {
+		gs_free char *checksum = NULL;
+
+		checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, result->path, -1);
+		blob_prefix = g_strdup_printf ("%s-%.8s", basename, checksum);
+	}
+
+	result->connection = _do_import_file (result->path, blob_prefix, &result->error);
+}
+
+/**
+ * do_import_batch:
+ * @paths: %NULL terminated list of files and directories
+ *
+ * Imports many configurations at once, parsing them on a pool of threads.
+ * Directories are expanded to the configuration files they contain. If
+ * several files have the same name, the files of their inline blobs get
+ * a hash of the configuration's path appended to the name.
+ *
+ * Returns: an array of #ImportBatchResult, in the order of @paths.
+ */
+GPtrArray *
+do_import_batch (const char *const *paths)
+{
+	GPtrArray *results;
+	GHashTable *basename_counts;
+	GThreadPool *pool;
+	long n_cpus;
+	guint i;
+
+	results = g_ptr_array_new_with_free_func ((GDestroyNotify) import_batch_result_free);
+	for (i = 0; paths && paths[i]; i++)
+		_import_batch_add_path (results, paths[i]);
+
+	basename_counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; i < results->len; i++) {
+		ImportBatchResult *result = results->pdata[i];
+		char *basename;
+		guint count;
+
+		if (result->error)
+			continue;
+		basename = _import_basename (result->path);
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (basename_counts, basename));
+		g_hash_table_insert (basename_counts, basename, GUINT_TO_POINTER (count + 1));
+	}
+
+	n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	pool = g_thread_pool_new (_import_batch_thread,
+	                          basename_counts,
+	                          CLAMP (n_cpus, 1, 16),
+	                          FALSE,
+	                          NULL);
+	for (i = 0; i < results->len; i++) {
+		ImportBatchResult *result = results->pdata[i];
+
+		if (!result->error)
+			g_thread_pool_push (pool, result, NULL);
+	}
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_hash_table_unref (basename_counts);
+
+	/* only once the threads are done: until a stored blob is linked to
+	 * the file of its connection, it looks unused. */
+	do_import_gc_blobs ();
+
+	return results;
+}
+
 /*****************************************************************************/
 
 static const char *
@@ -2072,6 +2511,12 @@ do_export_create (NMConnection *connection, const char *path, GError **error)
 	return g_steal_pointer (&f);
 }
 
+GString *
+_nmovpn_test_do_export_create (NMConnection *connection, const char *path, GError **error)
+{
+	return do_export_create (connection, path, error);
+}
+
 gboolean
 do_export (const char *path, NMConnection *connection, GError **error)
 {
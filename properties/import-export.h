@@ -29,8 +29,22 @@ gboolean _nmovpn_test_args_parse_line (const char *line,
                                        const char ***out_p,
                                        char **out_error);
 
+GString *_nmovpn_test_do_export_create (NMConnection *connection, const char *path, GError **error);
+
 NMConnection *do_import (const char *path, const char *contents, gsize contents_len, GError **error);
 
+NMConnection *do_import_file (const char *path, GError **error);
+
+typedef struct {
+	char *path;
+	NMConnection *connection;
+	GError *error;
+} ImportBatchResult;
+
+GPtrArray *do_import_batch (const char *const *paths);
+
+void do_import_gc_blobs (void);
+
 gboolean do_export (const char *path, NMConnection *connection, GError **error);
 
 #endif
@@ -37,6 +37,7 @@
 #include <gtk/gtk.h>
 
 #include "auth-helpers.h"
+#include "utils.h"
 
 /*****************************************************************************/
 
@@ -193,11 +194,21 @@ advanced_dialog_close_cb (GtkWidget *dialog, gpointer user_data)
 	gtk_widget_destroy (dialog);
 }
 
+static void
+hash_keep_hidden (gpointer key, gpointer data, gpointer user_data)
+{
+	const NMVPropertyInfo *info = nmv_property_info_lookup (key);
+
+	if (info && NM_FLAGS_HAS (info->flags, NMV_PROPERTY_FLAG_HIDDEN))
+		g_hash_table_insert ((GHashTable *) user_data, g_strdup (key), g_strdup (data));
+}
+
 static void
 advanced_dialog_response_cb (GtkWidget *dialog, gint response, gpointer user_data)
 {
 	OpenvpnEditor *self = OPENVPN_EDITOR (user_data);
 	OpenvpnEditorPrivate *priv = OPENVPN_EDITOR_GET_PRIVATE (self);
+	GHashTable *old_advanced;
 	GError *error = NULL;
 
 	if (response != GTK_RESPONSE_OK) {
@@ -205,13 +216,18 @@ advanced_dialog_response_cb (GtkWidget *dialog, gint response, gpointer user_dat
 		return;
 	}
 
-	if (priv->advanced)
-		g_hash_table_destroy (priv->advanced);
+	old_advanced = priv->advanced;
 	priv->advanced = advanced_dialog_new_hash_from_dialog (dialog, &error);
 	if (!priv->advanced) {
 		g_message ("%s: error reading advanced settings: %s", __func__, error->message);
 		g_error_free (error);
 	}
+	if (old_advanced) {
+		/* the dialog has no widgets for these, don't lose them. */
+		if (priv->advanced)
+			g_hash_table_foreach (old_advanced, hash_keep_hidden, priv->advanced);
+		g_hash_table_destroy (old_advanced);
+	}
 	advanced_dialog_close_cb (dialog, self);
 
 	stuff_changed_cb (NULL, self);
@@ -374,11 +390,13 @@ hash_copy_advanced (gpointer key, gpointer data, gpointer user_data)
 {
 	NMSettingVpn *s_vpn = NM_SETTING_VPN (user_data);
 	const char *value = (const char *) data;
+	const NMVPropertyInfo *info;
 
 	g_return_if_fail (value && strlen (value));
 
-	/* HTTP Proxy password is a secret, not a data item */
-	if (!strcmp (key, NM_OPENVPN_KEY_HTTP_PROXY_PASSWORD))
+	/* the HTTP proxy password is a secret, not a data item */
+	info = nmv_property_info_lookup (key);
+	if (info && !NM_FLAGS_HAS (info->flags, NMV_PROPERTY_FLAG_DATA))
 		nm_setting_vpn_add_secret (s_vpn, (const char *) key, value);
 	else
 		nm_setting_vpn_add_data_item (s_vpn, (const char *) key, value);
@@ -0,0 +1,174 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Imports many OpenVPN configurations at once, for provisioning.
+ *
+ * Usage: nm-openvpn-import-batch [--add] PATH...
+ *
+ * Each PATH is a configuration file or a directory of them. Without --add,
+ * the files are only parsed and the result is reported. With --add, the
+ * connections are added to NetworkManager.
+ */
+
+#include "nm-default.h"
+
+#include <stdlib.h>
+#include <locale.h>
+
+#include "import-export.h"
+
+/*****************************************************************************/
+
+typedef struct {
+	GMainLoop *loop;
+	guint pending;
+	gboolean failed;
+} AddData;
+
+typedef struct {
+	AddData *add_data;
+	char *path;
+} AddRequest;
+
+static void
+add_connection_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	AddRequest *req = user_data;
+	gs_unref_object NMRemoteConnection *remote = NULL;
+	GError *error = NULL;
+
+	remote = nm_client_add_connection_finish (NM_CLIENT (source), result, &error);
+	if (!remote) {
+		g_printerr ("%s: cannot add connection: %s\n", req->path, error->message);
+		g_error_free (error);
+		req->add_data->failed = TRUE;
+	} else
+		g_print ("%s: added as %s\n", req->path, nm_connection_get_uuid (NM_CONNECTION (remote)));
+
+	if (--req->add_data->pending == 0)
+		g_main_loop_quit (req->add_data->loop);
+	g_free (req->path);
+	g_slice_free (AddRequest, req);
+}
+
+static gboolean
+add_connections (GPtrArray *results)
+{
+	gs_unref_object NMClient *client = NULL;
+	AddData add_data = { 0 };
+	GError *error = NULL;
+	guint i;
+
+	client = nm_client_new (NULL, &error);
+	if (!client) {
+		g_printerr ("cannot connect to NetworkManager: %s\n", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	add_data.loop = g_main_loop_new (NULL, FALSE);
+
+	for (i = 0; i < results->len; i++) {
+		ImportBatchResult *result = results->pdata[i];
+		NMSettingConnection *s_con;
+		AddRequest *req;
+		gs_free char *uuid = NULL;
+
+		if (!result->connection)
+			continue;
+
+		/* like the editor does after importing. */
+		s_con = nm_connection_get_setting_connection (result->connection);
+		uuid = nm_utils_uuid_generate ();
+		g_object_set (s_con, NM_SETTING_CONNECTION_UUID, uuid, NULL);
+
+		req = g_slice_new (AddRequest);
+		req->add_data = &add_data;
+		req->path = g_strdup (result->path);
+		add_data.pending++;
+		nm_client_add_connection_async (client, result->connection, TRUE, NULL,
+		                                add_connection_cb, req);
+	}
+
+	if (add_data.pending)
+		g_main_loop_run (add_data.loop);
+	g_main_loop_unref (add_data.loop);
+
+	return !add_data.failed;
+}
+
+/*****************************************************************************/
+
+int
+main (int argc, char **argv)
+{
+	gboolean add = FALSE;
+	gs_strfreev char **paths = NULL;
+	GOptionContext *opt_ctx;
+	GPtrArray *results;
+	GError *error = NULL;
+	gboolean success = TRUE;
+	guint i;
+	GOptionEntry options[] = {
+		{ "add", 0, 0, G_OPTION_ARG_NONE, &add, "Add the imported connections to NetworkManager", NULL },
+		{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &paths, NULL, "PATH..." },
+		{ NULL }
+	};
+
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+
+	setlocale (LC_ALL, "");
+
+	opt_ctx = g_option_context_new (NULL);
+	g_option_context_set_summary (opt_ctx, "Import OpenVPN configuration files and directories of them.");
+	g_option_context_add_main_entries (opt_ctx, options, NULL);
+	if (!g_option_context_parse (opt_ctx, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (opt_ctx);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (opt_ctx);
+
+	if (!paths || !paths[0]) {
+		g_printerr ("no files given\n");
+		return EXIT_FAILURE;
+	}
+
+	results = do_import_batch ((const char *const *) paths);
+
+	for (i = 0; i < results->len; i++) {
+		ImportBatchResult *result = results->pdata[i];
+
+		if (result->error) {
+			g_printerr ("%s: %s\n", result->path, result->error->message);
+			success = FALSE;
+		} else if (!add) {
+			g_print ("%s: %s\n", result->path,
+			         nm_connection_get_id (result->connection));
+		}
+	}
+
+	if (add && !add_connections (results))
+		success = FALSE;
+
+	g_ptr_array_unref (results);
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,240 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Times args_parse_line(), do_import() and do_export_create() on
+ * generated configurations, with many routes and remotes, quoted
+ * arguments and a large inline <ca>.
+ *
+ * Usage: bench-import-export [N_ROUTES [N_REMOTES [BLOB_KB]]]
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "import-export.h"
+
+#include "bench-utils.h"
+
+#define N_ITERATIONS 5
+
+/*****************************************************************************/
+
+static GString *
+_generate_config (guint n_routes, guint n_remotes, guint blob_kb, gsize *out_n_lines)
+{
+	GString *f;
+	gsize n_lines = 0;
+	guint i;
+
+	f = g_string_sized_new (64 * (n_routes + n_remotes) + 1024 * blob_kb + 1024);
+
+	g_string_append (f, "client\n"
+	                    "dev tun\n"
+	                    "proto udp\n"
+	                    "nobind\n"
+	                    "auth-user-pass\n"
+	                    "cipher AES-256-CBC\n"
+	                    "verb 3\n");
+	n_lines += 7;
+
+	for (i = 0; i < n_remotes; i++) {
+		g_string_append_printf (f, "remote gw%u.example.com %u %s\n",
+		                        i, 1194 + (i % 4), (i % 2) ? "udp" : "tcp");
+		n_lines++;
+	}
+
+	/* mix unquoted, double quoted and single quoted arguments. */
+	for (i = 0; i < n_routes; i++) {
+		guint a = (i >> 8) & 0xFF, b = i & 0xFF;
+
+		switch (i % 3) {
+		case 0:
+			g_string_append_printf (f, "route 10.%u.%u.0 255.255.255.0\n", a, b);
+			break;
+		case 1:
+			g_string_append_printf (f, "route \"10.%u.%u.0\" \"255.255.255.0\" 10.8.0.1\n", a, b);
+			break;
+		default:
+			g_string_append_printf (f, "route '10.%u.%u.0' '255.255.255.0' 10.8.0.1 %u\n", a, b, i % 100);
+			break;
+		}
+		n_lines++;
+	}
+
+	g_string_append (f, "<ca>\n-----BEGIN CERTIFICATE-----\n");
+	n_lines += 2;
+	for (i = 0; i < blob_kb * 16; i++) {
+		g_string_append_printf (f, "%063u\n", i);
+		n_lines++;
+	}
+	g_string_append (f, "-----END CERTIFICATE-----\n</ca>\n");
+	n_lines += 2;
+
+	*out_n_lines = n_lines;
+	return f;
+}
+
+static void
+_remove_dir (const char *path)
+{
+	GDir *dir;
+	const char *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir))) {
+			gs_free char *child = g_build_filename (path, name, NULL);
+
+			if (g_file_test (child, G_FILE_TEST_IS_DIR))
+				_remove_dir (child);
+			else
+				unlink (child);
+		}
+		g_dir_close (dir);
+	}
+	rmdir (path);
+}
+
+/*****************************************************************************/
+
+static void
+_bench_parse (const GString *config, gsize n_lines)
+{
+	NMOvpnBench bench;
+	guint n;
+
+	nmovpn_bench_start (&bench, "args_parse_line");
+	for (n = 0; n < N_ITERATIONS; n++) {
+		const char *line = config->str;
+		const char *end = config->str + config->len;
+
+		while (line < end) {
+			const char *eol = memchr (line, '\n', end - line);
+			gsize len = (eol ? eol : end) - line;
+			gs_free const char **p = NULL;
+			gs_free char *line_error = NULL;
+
+			_nmovpn_test_args_parse_line (line, len, &p, &line_error);
+			line = eol ? eol + 1 : end;
+		}
+	}
+	nmovpn_bench_stop_items (&bench, N_ITERATIONS, n_lines, "line");
+}
+
+static NMConnection *
+_bench_import (const char *path, const GString *config, gsize n_lines)
+{
+	NMConnection *connection = NULL;
+	NMOvpnBench bench;
+	GError *error = NULL;
+	guint n;
+
+	nmovpn_bench_start (&bench, "do_import");
+	for (n = 0; n < N_ITERATIONS; n++) {
+		g_clear_object (&connection);
+		connection = do_import (path, config->str, config->len, &error);
+		if (!connection)
+			g_error ("import failed: %s", error->message);
+	}
+	nmovpn_bench_stop_items (&bench, N_ITERATIONS, n_lines, "line");
+
+	return connection;
+}
+
+static void
+_bench_export (const char *path, NMConnection *connection, gsize n_lines)
+{
+	NMOvpnBench bench;
+	GError *error = NULL;
+	guint n;
+
+	nmovpn_bench_start (&bench, "do_export_create");
+	for (n = 0; n < N_ITERATIONS; n++) {
+		GString *f;
+
+		f = _nmovpn_test_do_export_create (connection, path, &error);
+		if (!f)
+			g_error ("export failed: %s", error->message);
+		g_string_free (f, TRUE);
+	}
+	nmovpn_bench_stop_items (&bench, N_ITERATIONS, n_lines, "line");
+}
+
+static void
+_bench (const char *tmpdir, guint n_routes, guint n_remotes, guint blob_kb)
+{
+	gs_free char *path = NULL;
+	gs_unref_object NMConnection *connection = NULL;
+	GString *config;
+	gsize n_lines;
+
+	config = _generate_config (n_routes, n_remotes, blob_kb, &n_lines);
+	path = g_build_filename (tmpdir, "bench.ovpn", NULL);
+
+	g_print ("\n%u routes, %u remotes, %u KB blob: %"G_GSIZE_FORMAT" lines, %"G_GSIZE_FORMAT" bytes\n",
+	         n_routes, n_remotes, blob_kb, n_lines, config->len);
+
+	_bench_parse (config, n_lines);
+	connection = _bench_import (path, config, n_lines);
+	_bench_export (path, connection, n_lines);
+
+	g_string_free (config, TRUE);
+}
+
+int
+main (int argc, char **argv)
+{
+	static const guint default_routes[] = { 1000, 10000, 50000 };
+	gs_free char *tmpdir = NULL;
+	GError *error = NULL;
+	guint n_remotes = 100;
+	guint blob_kb = 64;
+	guint i;
+
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+
+	nmovpn_bench_init ();
+
+	/* inline blobs are written out on import, keep them out of $HOME. */
+	tmpdir = g_dir_make_tmp ("bench-import-export-XXXXXX", &error);
+	if (!tmpdir)
+		g_error ("cannot create temporary directory: %s", error->message);
+	_nmovpn_test_temp_path = tmpdir;
+
+	if (argc > 2)
+		n_remotes = g_ascii_strtoull (argv[2], NULL, 10);
+	if (argc > 3)
+		blob_kb = g_ascii_strtoull (argv[3], NULL, 10);
+
+	if (argc > 1)
+		_bench (tmpdir, g_ascii_strtoull (argv[1], NULL, 10), n_remotes, blob_kb);
+	else {
+		for (i = 0; i < G_N_ELEMENTS (default_routes); i++)
+			_bench (tmpdir, default_routes[i], n_remotes, blob_kb);
+	}
+
+	g_print ("\n");
+	nmovpn_bench_print_peak_rss ();
+
+	_remove_dir (tmpdir);
+	return 0;
+}
@@ -0,0 +1,131 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __NMOVPN_BENCH_UTILS_H__
+#define __NMOVPN_BENCH_UTILS_H__
+
+/* Helpers for the benchmark programs. They are not run as part of
+ * "make check", but built so that they can be run by hand.
+ *
+ * This header must be included by exactly one translation unit of the
+ * benchmark, because it replaces malloc() to count allocations. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+/*****************************************************************************/
+
+static volatile gsize _nmovpn_bench_n_allocs;
+
+#if defined (__GLIBC__)
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+void *
+malloc (size_t size)
+{
+	_nmovpn_bench_n_allocs++;
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+	_nmovpn_bench_n_allocs++;
+	return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+	_nmovpn_bench_n_allocs++;
+	return __libc_realloc (ptr, size);
+}
+
+#define NMOVPN_BENCH_COUNTS_ALLOCS 1
+
+#else
+
+#define NMOVPN_BENCH_COUNTS_ALLOCS 0
+
+#endif
+
+/*****************************************************************************/
+
+typedef struct {
+	const char *name;
+	gint64 time_usec;
+	gsize n_allocs;
+} NMOvpnBench;
+
+static inline void
+nmovpn_bench_init (void)
+{
+	/* make GSlice use malloc(), so that its allocations are counted too. */
+	g_setenv ("G_SLICE", "always-malloc", TRUE);
+}
+
+static inline void
+nmovpn_bench_start (NMOvpnBench *bench, const char *name)
+{
+	bench->name = name;
+	bench->n_allocs = _nmovpn_bench_n_allocs;
+	bench->time_usec = g_get_monotonic_time ();
+}
+
+static inline void
+nmovpn_bench_stop_items (NMOvpnBench *bench, guint n_iterations, gsize n_items, const char *item)
+{
+	bench->time_usec = g_get_monotonic_time () - bench->time_usec;
+	bench->n_allocs = _nmovpn_bench_n_allocs - bench->n_allocs;
+
+	if (n_iterations > 1) {
+		bench->time_usec /= n_iterations;
+		bench->n_allocs /= n_iterations;
+	}
+
+	g_print ("%-40s %10.3f ms", bench->name, bench->time_usec / 1000.0);
+	if (NMOVPN_BENCH_COUNTS_ALLOCS)
+		g_print (" %10"G_GSIZE_FORMAT" allocs", bench->n_allocs);
+	if (n_items > 0) {
+		g_print (" %10.1f ns/%s", bench->time_usec * 1000.0 / n_items, item);
+		if (NMOVPN_BENCH_COUNTS_ALLOCS)
+			g_print (" %8.2f allocs/%s", (double) bench->n_allocs / n_items, item);
+	}
+	g_print ("\n");
+}
+
+static inline void
+nmovpn_bench_stop (NMOvpnBench *bench, guint n_iterations)
+{
+	nmovpn_bench_stop_items (bench, n_iterations, 0, NULL);
+}
+
+static inline void
+nmovpn_bench_print_peak_rss (void)
+{
+	struct rusage usage;
+
+	/* ru_maxrss is in kilobytes on Linux. */
+	if (getrusage (RUSAGE_SELF, &usage) == 0)
+		g_print ("peak RSS: %ld kB\n", usage.ru_maxrss);
+}
+
+#endif /* __NMOVPN_BENCH_UTILS_H__ */
@@ -28,7 +28,10 @@
 #define NM_DBUS_INTERFACE_OPENVPN  "org.freedesktop.NetworkManager.openvpn"
 #define NM_DBUS_PATH_OPENVPN       "/org/freedesktop/NetworkManager/openvpn"
 
+#define NM_OPENVPN_KEY_AGGREGATE_ROUTES "aggregate-routes"
 #define NM_OPENVPN_KEY_AUTH "auth"
+#define NM_OPENVPN_KEY_BYTECOUNT_INTERVAL "bytecount-interval"
+#define NM_OPENVPN_KEY_BYTECOUNT_WINDOW "bytecount-window"
 #define NM_OPENVPN_KEY_CA "ca"
 #define NM_OPENVPN_KEY_CERT "cert"
 #define NM_OPENVPN_KEY_CIPHER "cipher"
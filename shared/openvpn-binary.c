@@ -0,0 +1,332 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "nm-default.h"
+
+#include "openvpn-binary.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/*****************************************************************************/
+
+/* Where openvpn lives and what it supports only changes when the binary
+ * is replaced. The service needs the location, the editor also the
+ * ciphers and digests. Asking openvpn means spawning it, so keep the
+ * answers in memory and in a small cache file, keyed by the path, inode
+ * and mtime of the binary. */
+
+static const char *cap_options[_NMOVPN_CAP_NUM] = {
+	[NMOVPN_CAP_CIPHERS] = "--show-ciphers",
+	[NMOVPN_CAP_DIGESTS] = "--show-digests",
+};
+
+static const char *cap_keys[_NMOVPN_CAP_NUM] = {
+	[NMOVPN_CAP_CIPHERS] = "ciphers",
+	[NMOVPN_CAP_DIGESTS] = "digests",
+};
+
+static struct {
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	gint64 mtime;
+	char **caps[_NMOVPN_CAP_NUM];
+} binary_info;
+
+/*****************************************************************************/
+
+const char *
+nmovpn_binary_find (void)
+{
+	static const char *openvpn_binary_paths[] = {
+		"/usr/sbin/openvpn",
+		"/sbin/openvpn",
+		"/usr/local/sbin/openvpn",
+		NULL
+	};
+	static const char *found = NULL;
+	const char **openvpn_binary = openvpn_binary_paths;
+
+	if (found && g_file_test (found, G_FILE_TEST_EXISTS))
+		return found;
+
+	while (*openvpn_binary != NULL) {
+		if (g_file_test (*openvpn_binary, G_FILE_TEST_EXISTS))
+			break;
+		openvpn_binary++;
+	}
+
+	found = *openvpn_binary;
+	return found;
+}
+
+/* Parses the output of "openvpn --show-ciphers" and the like: the list
+ * starts after the first blank line, and any further blank line starts
+ * or ends a comment. Of each line, only the first word counts. */
+char **
+nmovpn_binary_parse_list (const char *output)
+{
+	GPtrArray *list;
+	gs_strfreev char **lines = NULL;
+	gboolean ignore_lines = TRUE;
+	char **line;
+
+	list = g_ptr_array_new ();
+	lines = g_strsplit (output ?: "", "\n", 0);
+	for (line = lines; *line; line++) {
+		char *space;
+
+		if (!(*line)[0]) {
+			ignore_lines = !ignore_lines;
+			continue;
+		}
+		if (ignore_lines)
+			continue;
+
+		space = strchr (*line, ' ');
+		if (space)
+			*space = '\0';
+		if ((*line)[0])
+			g_ptr_array_add (list, g_strdup (*line));
+	}
+	g_ptr_array_add (list, NULL);
+
+	return (char **) g_ptr_array_free (list, FALSE);
+}
+
+/*****************************************************************************/
+
+static char *
+_cache_file (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "network-manager-openvpn", "openvpn-binary", NULL);
+}
+
+static gboolean
+_cache_group_valid (GKeyFile *keyfile, const char *group)
+{
+	GError *error = NULL;
+	gint64 mtime, ino;
+
+	mtime = g_key_file_get_int64 (keyfile, group, "mtime", &error);
+	if (!error)
+		ino = g_key_file_get_int64 (keyfile, group, "inode", &error);
+	if (error) {
+		g_error_free (error);
+		return FALSE;
+	}
+	return    mtime == binary_info.mtime
+	       && ino == (gint64) binary_info.ino;
+}
+
+static void
+_cache_load (void)
+{
+	gs_free char *filename = _cache_file ();
+	GKeyFile *keyfile;
+	guint i;
+
+	keyfile = g_key_file_new ();
+	if (   !g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL)
+	    || !_cache_group_valid (keyfile, binary_info.path)) {
+		g_key_file_free (keyfile);
+		return;
+	}
+
+	for (i = 0; i < _NMOVPN_CAP_NUM; i++)
+		binary_info.caps[i] = g_key_file_get_string_list (keyfile, binary_info.path, cap_keys[i], NULL, NULL);
+	g_key_file_free (keyfile);
+}
+
+static void
+_cache_save (void)
+{
+	gs_free char *filename = _cache_file ();
+	gs_free char *dirname = NULL;
+	gs_free char *data = NULL;
+	GKeyFile *keyfile;
+	gsize len;
+	guint i;
+
+	keyfile = g_key_file_new ();
+	g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_KEEP_COMMENTS, NULL);
+
+	g_key_file_remove_group (keyfile, binary_info.path, NULL);
+	g_key_file_set_int64 (keyfile, binary_info.path, "mtime", binary_info.mtime);
+	g_key_file_set_int64 (keyfile, binary_info.path, "inode", binary_info.ino);
+	for (i = 0; i < _NMOVPN_CAP_NUM; i++) {
+		if (binary_info.caps[i]) {
+			g_key_file_set_string_list (keyfile, binary_info.path, cap_keys[i],
+			                            (const char *const *) binary_info.caps[i],
+			                            g_strv_length (binary_info.caps[i]));
+		}
+	}
+
+	data = g_key_file_to_data (keyfile, &len, NULL);
+	g_key_file_free (keyfile);
+
+	/* the cache is only an optimization, ignore errors. */
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0700) == 0)
+		g_file_set_contents (filename, data, len, NULL);
+}
+
+/* Returns TRUE if @binary exists and binary_info describes it. */
+static gboolean
+_binary_info_update (const char *binary)
+{
+	struct stat st;
+	guint i;
+
+	if (!binary || stat (binary, &st) != 0)
+		return FALSE;
+
+	if (   nm_streq0 (binary_info.path, binary)
+	    && binary_info.dev == st.st_dev
+	    && binary_info.ino == st.st_ino
+	    && binary_info.mtime == (gint64) st.st_mtime)
+		return TRUE;
+
+	g_free (binary_info.path);
+	for (i = 0; i < _NMOVPN_CAP_NUM; i++)
+		g_clear_pointer (&binary_info.caps[i], g_strfreev);
+
+	binary_info.path = g_strdup (binary);
+	binary_info.dev = st.st_dev;
+	binary_info.ino = st.st_ino;
+	binary_info.mtime = st.st_mtime;
+
+	_cache_load ();
+	return TRUE;
+}
+
+/*****************************************************************************/
+
+typedef struct {
+	char *binary;
+	NMOvpnCap cap;
+	GCancellable *cancellable;
+	NMOvpnCapCallback callback;
+	gpointer user_data;
+	GString *output;
+} CapRequest;
+
+static void
+_cap_request_complete (CapRequest *req, gboolean success)
+{
+	const char *const *items = NULL;
+
+	if (   success
+	    && _binary_info_update (req->binary)) {
+		if (!binary_info.caps[req->cap]) {
+			binary_info.caps[req->cap] = nmovpn_binary_parse_list (req->output->str);
+			_cache_save ();
+		}
+		items = (const char *const *) binary_info.caps[req->cap];
+	}
+
+	if (!req->cancellable || !g_cancellable_is_cancelled (req->cancellable))
+		req->callback (items, req->user_data);
+
+	g_free (req->binary);
+	g_clear_object (&req->cancellable);
+	g_string_free (req->output, TRUE);
+	g_slice_free (CapRequest, req);
+}
+
+static gboolean
+_cap_request_read_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	CapRequest *req = user_data;
+	char buf[4096];
+	gsize n = 0;
+	GIOStatus status;
+
+	status = g_io_channel_read_chars (channel, buf, sizeof (buf), &n, NULL);
+	if (n)
+		g_string_append_len (req->output, buf, n);
+
+	if (status == G_IO_STATUS_NORMAL || status == G_IO_STATUS_AGAIN)
+		return G_SOURCE_CONTINUE;
+
+	_cap_request_complete (req, status == G_IO_STATUS_EOF);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+_cap_request_child_cb (GPid pid, gint status, gpointer user_data)
+{
+	g_spawn_close_pid (pid);
+}
+
+/* Asks openvpn for the list of @cap, without blocking while openvpn runs.
+ * If the answer is already known, @callback is invoked right away,
+ * otherwise from the main loop once openvpn exited, unless @cancellable
+ * was cancelled. @items is %NULL if openvpn could not be asked. */
+void
+nmovpn_binary_get_capability_async (const char *binary,
+                                    NMOvpnCap cap,
+                                    GCancellable *cancellable,
+                                    NMOvpnCapCallback callback,
+                                    gpointer user_data)
+{
+	const char *argv[] = { binary, cap_options[cap], NULL };
+	GError *error = NULL;
+	CapRequest *req;
+	GIOChannel *channel;
+	GPid pid;
+	int fd;
+
+	g_return_if_fail (cap < _NMOVPN_CAP_NUM);
+	g_return_if_fail (callback);
+
+	if (!_binary_info_update (binary)) {
+		callback (NULL, user_data);
+		return;
+	}
+	if (binary_info.caps[cap]) {
+		callback ((const char *const *) binary_info.caps[cap], user_data);
+		return;
+	}
+
+	if (!g_spawn_async_with_pipes ("/", (char **) argv, NULL,
+	                               G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL,
+	                               NULL, NULL, &pid, NULL, &fd, NULL, &error)) {
+		g_warning ("couldn't run \"%s %s\": %s", binary, cap_options[cap], error->message);
+		g_error_free (error);
+		callback (NULL, user_data);
+		return;
+	}
+	g_child_watch_add (pid, _cap_request_child_cb, NULL);
+
+	req = g_slice_new0 (CapRequest);
+	req->binary = g_strdup (binary);
+	req->cap = cap;
+	req->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	req->callback = callback;
+	req->user_data = user_data;
+	req->output = g_string_new (NULL);
+
+	channel = g_io_channel_unix_new (fd);
+	g_io_channel_set_close_on_unref (channel, TRUE);
+	g_io_channel_set_encoding (channel, NULL, NULL);
+	g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+	g_io_add_watch (channel, G_IO_IN | G_IO_HUP | G_IO_ERR, _cap_request_read_cb, req);
+	g_io_channel_unref (channel);
+}
@@ -0,0 +1,39 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __NMOVPN_OPENVPN_BINARY_H__
+#define __NMOVPN_OPENVPN_BINARY_H__
+
+typedef enum {
+	NMOVPN_CAP_CIPHERS,
+	NMOVPN_CAP_DIGESTS,
+	_NMOVPN_CAP_NUM,
+} NMOvpnCap;
+
+const char *nmovpn_binary_find (void);
+
+typedef void (*NMOvpnCapCallback) (const char *const *items, gpointer user_data);
+
+void nmovpn_binary_get_capability_async (const char *binary,
+                                         NMOvpnCap cap,
+                                         GCancellable *cancellable,
+                                         NMOvpnCapCallback callback,
+                                         gpointer user_data);
+
+char **nmovpn_binary_parse_list (const char *output);
+
+#endif /* __NMOVPN_OPENVPN_BINARY_H__ */
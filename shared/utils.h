@@ -74,6 +74,17 @@
 #define NMV_OVPN_TAG_USER               "user"
 #define NMV_OVPN_TAG_VERIFY_X509_NAME   "verify-x509-name"
 
+typedef enum {
+	NMV_KEY_FORMAT_UNKNOWN = 0,
+	NMV_KEY_FORMAT_PEM_RSA,
+	NMV_KEY_FORMAT_PEM_DSA,
+	NMV_KEY_FORMAT_PEM_EC,
+	NMV_KEY_FORMAT_PKCS8,
+	NMV_KEY_FORMAT_PKCS12,
+} NMVKeyFormat;
+
+NMVKeyFormat nmv_utils_key_classify (const char *filename, gboolean *out_encrypted);
+
 gboolean is_pkcs12 (const char *filepath);
 
 gboolean is_encrypted (const char *filename);
@@ -83,4 +94,31 @@ const char *nmv_utils_str_utf8safe_escape_c   (const char *str, char **out_clone
 char *      nmv_utils_str_utf8safe_unescape   (const char *str);
 const char *nmv_utils_str_utf8safe_unescape_c (const char *str, char **str_free);
 
+char *nmv_utils_routes_digest (GVariant *routes);
+
+typedef enum {
+	NMV_PROPERTY_FLAG_NONE     = 0,
+	/* valid as a data item of the VPN setting */
+	NMV_PROPERTY_FLAG_DATA     = (1LL << 0),
+	/* valid as a secret of the VPN setting */
+	NMV_PROPERTY_FLAG_SECRET   = (1LL << 1),
+	/* edited in the advanced dialog */
+	NMV_PROPERTY_FLAG_ADVANCED = (1LL << 2),
+	/* a DNS name or an IP address */
+	NMV_PROPERTY_FLAG_ADDRESS  = (1LL << 3),
+	/* not shown by the editor, which keeps the value as it is */
+	NMV_PROPERTY_FLAG_HIDDEN   = (1LL << 4),
+} NMVPropertyFlags;
+
+typedef struct {
+	const char *name;
+	/* G_TYPE_STRING, G_TYPE_INT or G_TYPE_BOOLEAN ("yes" or "no") */
+	GType type;
+	gint int_min;
+	gint int_max;
+	NMVPropertyFlags flags;
+} NMVPropertyInfo;
+
+const NMVPropertyInfo *nmv_property_info_lookup (const char *name);
+
 #endif  /* UTILS_H */
@@ -0,0 +1,869 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* nm-openvpn-service-openvpn-helper - parsing of the environment
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * (C) Copyright 2005 Red Hat, Inc.
+ * (C) Copyright 2005 Tim Niemueller
+ */
+
+#include "nm-default.h"
+
+#include "nm-openvpn-helper-env.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <syslog.h>
+
+#include "utils.h"
+#include "nm-openvpn-helper-resolve.h"
+#include "nm-openvpn-helper-routes.h"
+
+/* how long to wait for the lookup of the gateway's name. */
+#define RESOLVE_TIMEOUT_MSEC 5000
+
+/*****************************************************************************/
+
+/* openvpn passes routes and options as numbered environment variables,
+ * like route_network_1, route_network_2, ... Index all of them with a
+ * single pass over the environment instead of looking up each one with
+ * getenv(), which would scan the environment every time. */
+
+typedef enum {
+	ENV_ROUTE_NETWORK,
+	ENV_ROUTE_NETMASK,
+	ENV_ROUTE_GATEWAY,
+	ENV_ROUTE_METRIC,
+	ENV_ROUTE_IPV6_NETWORK,
+	ENV_ROUTE_IPV6_GATEWAY,
+	ENV_FOREIGN_OPTION,
+	_ENV_INDEXED_NUM,
+} EnvIndexed;
+
+static const struct {
+	const char *prefix;
+	gsize prefix_len;
+} env_indexed_info[_ENV_INDEXED_NUM] = {
+#define ENV_INDEXED(idx, prefix) [idx] = { prefix, NM_STRLEN (prefix) }
+	ENV_INDEXED (ENV_ROUTE_NETWORK,      "route_network_"),
+	ENV_INDEXED (ENV_ROUTE_NETMASK,      "route_netmask_"),
+	ENV_INDEXED (ENV_ROUTE_GATEWAY,      "route_gateway_"),
+	ENV_INDEXED (ENV_ROUTE_METRIC,       "route_metric_"),
+	ENV_INDEXED (ENV_ROUTE_IPV6_NETWORK, "route_ipv6_network_"),
+	ENV_INDEXED (ENV_ROUTE_IPV6_GATEWAY, "route_ipv6_gateway_"),
+	ENV_INDEXED (ENV_FOREIGN_OPTION,     "foreign_option_"),
+#undef ENV_INDEXED
+};
+
+typedef enum {
+	ENV_TRUSTED_IP6,
+	ENV_TRUSTED_IP,
+	ENV_REMOTE_1,
+	ENV_ROUTE_VPN_GATEWAY,
+	ENV_DEV,
+	ENV_IFCONFIG_LOCAL,
+	ENV_IFCONFIG_REMOTE,
+	ENV_IFCONFIG_NETMASK,
+	ENV_IFCONFIG_IPV6_LOCAL,
+	ENV_IFCONFIG_IPV6_REMOTE,
+	ENV_IFCONFIG_IPV6_NETBITS,
+	ENV_TUN_MTU,
+	_ENV_NAMED_NUM,
+} EnvNamed;
+
+static const struct {
+	const char *name;
+	gsize name_len;
+} env_named_info[_ENV_NAMED_NUM] = {
+#define ENV_NAMED(idx, name) [idx] = { name, NM_STRLEN (name) }
+	ENV_NAMED (ENV_TRUSTED_IP6,           "trusted_ip6"),
+	ENV_NAMED (ENV_TRUSTED_IP,            "trusted_ip"),
+	ENV_NAMED (ENV_REMOTE_1,              "remote_1"),
+	ENV_NAMED (ENV_ROUTE_VPN_GATEWAY,     "route_vpn_gateway"),
+	ENV_NAMED (ENV_DEV,                   "dev"),
+	ENV_NAMED (ENV_IFCONFIG_LOCAL,        "ifconfig_local"),
+	ENV_NAMED (ENV_IFCONFIG_REMOTE,       "ifconfig_remote"),
+	ENV_NAMED (ENV_IFCONFIG_NETMASK,      "ifconfig_netmask"),
+	ENV_NAMED (ENV_IFCONFIG_IPV6_LOCAL,   "ifconfig_ipv6_local"),
+	ENV_NAMED (ENV_IFCONFIG_IPV6_REMOTE,  "ifconfig_ipv6_remote"),
+	ENV_NAMED (ENV_IFCONFIG_IPV6_NETBITS, "ifconfig_ipv6_netbits"),
+	ENV_NAMED (ENV_TUN_MTU,               "tun_mtu"),
+#undef ENV_NAMED
+};
+
+typedef struct {
+	const NMOvpnHelperEnvOptions *options;
+	guint len;
+	const char **indexed[_ENV_INDEXED_NUM];
+	const char *named[_ENV_NAMED_NUM];
+} EnvParser;
+
+/*****************************************************************************/
+
+#define _NMLOG(level, ...) \
+	G_STMT_START { \
+		if (   parser->options->log_func \
+		    && parser->options->log_level >= (level)) { \
+			gs_free char *_msg = g_strdup_printf (__VA_ARGS__); \
+			\
+			parser->options->log_func ((level), _msg, parser->options->log_user_data); \
+		} \
+	} G_STMT_END
+
+#define _LOGD(...) _NMLOG(LOG_INFO,    __VA_ARGS__)
+#define _LOGW(...) _NMLOG(LOG_WARNING, __VA_ARGS__)
+
+/*****************************************************************************/
+
+static gboolean
+env_index_add_indexed (EnvParser *parser, const char *e)
+{
+	guint i;
+
+	if (!NM_IN_SET (e[0], 'r', 'f'))
+		return FALSE;
+
+	for (i = 0; i < _ENV_INDEXED_NUM; i++) {
+		const char *p;
+		guint n = 0;
+
+		if (strncmp (e, env_indexed_info[i].prefix, env_indexed_info[i].prefix_len))
+			continue;
+
+		p = &e[env_indexed_info[i].prefix_len];
+		if (!g_ascii_isdigit (*p))
+			return FALSE;
+		for (; g_ascii_isdigit (*p); p++) {
+			n = (n * 10) + (*p - '0');
+			if (n > parser->len)
+				break;
+		}
+		if (n > 0 && n <= parser->len && *p == '=')
+			parser->indexed[i][n] = &p[1];
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+env_index_add_named (EnvParser *parser, const char *e)
+{
+	guint i;
+
+	for (i = 0; i < _ENV_NAMED_NUM; i++) {
+		if (   strncmp (e, env_named_info[i].name, env_named_info[i].name_len) == 0
+		    && e[env_named_info[i].name_len] == '=') {
+			/* like getenv(), the first one wins. */
+			if (!parser->named[i])
+				parser->named[i] = &e[env_named_info[i].name_len + 1];
+			return;
+		}
+	}
+}
+
+static void
+env_index_build (EnvParser *parser, char **env)
+{
+	guint i;
+	char **iter;
+
+	/* openvpn numbers the variables consecutively starting from 1, so a
+	 * number larger than the size of the environment can only come after
+	 * a gap, where we stop reading anyway. */
+	parser->len = env ? g_strv_length (env) : 0;
+	for (i = 0; i < _ENV_INDEXED_NUM; i++)
+		parser->indexed[i] = g_new0 (const char *, parser->len + 1);
+
+	for (iter = env; iter && *iter; iter++) {
+		if (!env_index_add_indexed (parser, *iter))
+			env_index_add_named (parser, *iter);
+	}
+}
+
+static void
+env_index_clear (EnvParser *parser)
+{
+	guint i;
+
+	for (i = 0; i < _ENV_INDEXED_NUM; i++)
+		g_clear_pointer (&parser->indexed[i], g_free);
+}
+
+static const char *
+env_index_get (EnvParser *parser, EnvIndexed idx, guint n)
+{
+	if (n == 0 || n > parser->len)
+		return NULL;
+	return parser->indexed[idx][n];
+}
+
+static const char *
+env_get (EnvParser *parser, EnvNamed idx)
+{
+	return parser->named[idx];
+}
+
+/*****************************************************************************/
+
+static GVariant *
+str_to_gvariant (const char *str, gboolean try_convert)
+{
+	/* Empty */
+	if (!str || strlen (str) < 1)
+		return NULL;
+
+	if (!g_utf8_validate (str, -1, NULL)) {
+		if (try_convert && !(str = g_convert (str, -1, "ISO-8859-1", "UTF-8", NULL, NULL, NULL)))
+			str = g_convert (str, -1, "C", "UTF-8", NULL, NULL, NULL);
+
+		if (!str)
+			/* Invalid */
+			return NULL;
+	}
+
+	return g_variant_new_string (str);
+}
+
+static GVariant *
+addr4_to_gvariant (const char *str)
+{
+	struct in_addr	temp_addr;
+
+	/* Empty */
+	if (!str || strlen (str) < 1)
+		return NULL;
+
+	if (inet_pton (AF_INET, str, &temp_addr) <= 0)
+		return NULL;
+
+	return g_variant_new_uint32 (temp_addr.s_addr);
+}
+
+static GVariant *
+addr6_to_gvariant (const char *str)
+{
+	struct in6_addr temp_addr;
+	GVariantBuilder builder;
+	int i;
+
+	/* Empty */
+	if (!str || strlen (str) < 1)
+		return NULL;
+
+	if (inet_pton (AF_INET6, str, &temp_addr) <= 0)
+		return NULL;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("ay"));
+	for (i = 0; i < sizeof (temp_addr); i++)
+		g_variant_builder_add (&builder, "y", ((guint8 *) &temp_addr)[i]);
+	return g_variant_builder_end (&builder);
+}
+
+static void
+parse_addr_list (GPtrArray *array4, GPtrArray *array6, const char *str)
+{
+	char **split;
+	int i;
+	GVariant *variant;
+
+	/* Empty */
+	if (!str || strlen (str) < 1)
+		return;
+
+	split = g_strsplit (str, " ", -1);
+	for (i = 0; split[i]; i++) {
+		if (array4 && (variant = addr4_to_gvariant (split[i])) != NULL)
+			g_ptr_array_add (array4, g_variant_ref_sink (variant));
+		else if (array6 && (variant = addr6_to_gvariant (split[i])) != NULL)
+			g_ptr_array_add (array6, g_variant_ref_sink (variant));
+	}
+
+	g_strfreev (split);
+
+	return;
+}
+
+static inline gboolean
+is_domain_valid (const char *str)
+{
+	return (str && (strlen(str) >= 1) && (strlen(str) <= 255));
+}
+
+/*****************************************************************************/
+
+static GVariant *
+get_ip4_routes (EnvParser *parser)
+{
+	GVariant *value = NULL;
+	GArray *routes;
+	const char *tmp;
+	guint i;
+
+	routes = g_array_new (FALSE, FALSE, sizeof (NMOvpnIP4Route));
+
+	for (i = 1; ; i++) {
+		NMOvpnIP4Route *route;
+		struct in_addr network;
+		struct in_addr netmask;
+		struct in_addr gateway = { 0, };
+		guint32 metric = 0;
+
+		tmp = env_index_get (parser, ENV_ROUTE_NETWORK, i);
+		if (!tmp || strlen (tmp) < 1)
+			break;
+
+		if (inet_pton (AF_INET, tmp, &network) <= 0) {
+			_LOGW ("Ignoring invalid static route address '%s'", tmp ? tmp : "NULL");
+			continue;
+		}
+
+		tmp = env_index_get (parser, ENV_ROUTE_NETMASK, i);
+		if (!tmp || inet_pton (AF_INET, tmp, &netmask) <= 0) {
+			_LOGW ("Ignoring invalid static route netmask '%s'", tmp ? tmp : "NULL");
+			continue;
+		}
+
+		tmp = env_index_get (parser, ENV_ROUTE_GATEWAY, i);
+		/* gateway can be missing */
+		if (tmp && (inet_pton (AF_INET, tmp, &gateway) <= 0)) {
+			_LOGW ("Ignoring invalid static route gateway '%s'", tmp ? tmp : "NULL");
+			continue;
+		}
+
+		tmp = env_index_get (parser, ENV_ROUTE_METRIC, i);
+		/* metric can be missing */
+		if (tmp && strlen (tmp)) {
+			long int tmp_metric;
+
+			errno = 0;
+			tmp_metric = strtol (tmp, NULL, 10);
+			if (errno || tmp_metric < 0 || tmp_metric > G_MAXUINT32) {
+				_LOGW ("Ignoring invalid static route metric '%s'", tmp);
+				continue;
+			}
+			metric = (guint32) tmp_metric;
+		}
+
+		g_array_set_size (routes, routes->len + 1);
+		route = &g_array_index (routes, NMOvpnIP4Route, routes->len - 1);
+		route->network = network.s_addr;
+		route->prefix = nm_utils_ip4_netmask_to_prefix (netmask.s_addr);
+		route->gateway = gateway.s_addr;
+		route->metric = metric;
+	}
+
+	if (parser->options->aggregate_routes && routes->len > 1) {
+		guint n;
+
+		n = nmovpn_ip4_routes_aggregate ((NMOvpnIP4Route *) routes->data, routes->len);
+		_LOGD ("aggregated %u IPv4 routes into %u", routes->len, n);
+		g_array_set_size (routes, n);
+	}
+
+	if (routes->len)
+		value = nmovpn_ip4_routes_to_variant ((NMOvpnIP4Route *) routes->data, routes->len);
+	g_array_unref (routes);
+
+	return value;
+}
+
+static GVariant *
+get_ip6_routes (EnvParser *parser)
+{
+	GVariant *value = NULL;
+	GArray *routes;
+	const char *tmp;
+	guint i;
+
+	routes = g_array_new (FALSE, TRUE, sizeof (NMOvpnIP6Route));
+
+	for (i = 1; ; i++) {
+		NMOvpnIP6Route *route;
+		struct in6_addr network;
+		struct in6_addr gateway = IN6ADDR_ANY_INIT;
+		gs_free char *dest = NULL;
+		const char *slash;
+		guint32 prefix;
+
+		tmp = env_index_get (parser, ENV_ROUTE_IPV6_NETWORK, i);
+		if (!tmp || strlen (tmp) < 1)
+			break;
+
+		/* Split network string in "dest/prefix" format */
+		slash = strchr (tmp, '/');
+		if (slash) {
+			long int tmp_prefix;
+
+			errno = 0;
+			tmp_prefix = strtol (slash + 1, NULL, 10);
+			if (errno || tmp_prefix <= 0 || tmp_prefix > 128) {
+				_LOGW ("Ignoring invalid static route prefix '%s'", slash + 1);
+				continue;
+			}
+			prefix = (guint32) tmp_prefix;
+		} else {
+			_LOGW ("Ignoring static route %u with no prefix length", i);
+			continue;
+		}
+
+		dest = g_strndup (tmp, slash - tmp);
+		if (inet_pton (AF_INET6, dest, &network) <= 0) {
+			_LOGW ("Ignoring invalid static route address '%s'", dest);
+			continue;
+		}
+
+		tmp = env_index_get (parser, ENV_ROUTE_IPV6_GATEWAY, i);
+		/* gateway can be missing */
+		if (tmp && inet_pton (AF_INET6, tmp, &gateway) <= 0) {
+			_LOGW ("Ignoring invalid static route gateway '%s'", tmp);
+			continue;
+		}
+
+		g_array_set_size (routes, routes->len + 1);
+		route = &g_array_index (routes, NMOvpnIP6Route, routes->len - 1);
+		route->network = network;
+		route->prefix = prefix;
+		route->gateway = gateway;
+		route->metric = 0;
+	}
+
+	if (parser->options->aggregate_routes && routes->len > 1) {
+		guint n;
+
+		n = nmovpn_ip6_routes_aggregate ((NMOvpnIP6Route *) routes->data, routes->len);
+		_LOGD ("aggregated %u IPv6 routes into %u", routes->len, n);
+		g_array_set_size (routes, n);
+	}
+
+	if (routes->len)
+		value = nmovpn_ip6_routes_to_variant ((NMOvpnIP6Route *) routes->data, routes->len);
+	g_array_unref (routes);
+
+	return value;
+}
+
+static gboolean
+routes_unchanged (GVariant *routes, const char *digest)
+{
+	gs_free char *routes_digest = NULL;
+
+	if (!digest || !digest[0])
+		return FALSE;
+
+	routes_digest = nmv_utils_routes_digest (routes);
+	return nm_streq (routes_digest, digest);
+}
+
+static GVariant *
+trusted_remote_to_gvariant (EnvParser *parser)
+{
+	const char *tmp;
+	GVariant *val = NULL;
+	const char *p;
+	gboolean is_name = FALSE;
+
+	tmp = env_get (parser, ENV_TRUSTED_IP6);
+	if (tmp) {
+		val = addr6_to_gvariant (tmp);
+		if (val == NULL) {
+			_LOGW ("failed to convert VPN gateway address '%s' (%d)",
+			       tmp, errno);
+			return NULL;
+		}
+		return val;
+	}
+
+	tmp = env_get (parser, ENV_TRUSTED_IP);
+	if (!tmp)
+		tmp = env_get (parser, ENV_REMOTE_1);
+	if (!tmp) {
+		_LOGW ("did not receive remote gateway address");
+		return NULL;
+	}
+
+	/* Check if it seems to be a hostname */
+	p = tmp;
+	while (*p) {
+		if (*p != '.' && !isdigit (*p)) {
+			is_name = TRUE;
+			break;
+		}
+		p++;
+	}
+
+	if (is_name && (val = addr6_to_gvariant (tmp)))
+		return val;
+
+	/* Resolve a hostname if required. openvpn exports the address it
+	 * connected to as trusted_ip/trusted_ip6, so this is only a fallback
+	 * and we cannot know which of several addresses openvpn picked. */
+	if (is_name) {
+		gs_unref_object GInetAddress *addr = NULL;
+		gs_free char *addr_str = NULL;
+		GError *error = NULL;
+
+		if (!parser->options->resolver) {
+			_LOGW ("not looking up VPN gateway address '%s'", tmp);
+			return NULL;
+		}
+
+		addr = nmovpn_resolve_remote (parser->options->resolver, tmp, RESOLVE_TIMEOUT_MSEC, &error);
+		if (!addr) {
+			_LOGW ("failed to look up VPN gateway address '%s': %s",
+			       tmp, error->message);
+			g_error_free (error);
+			return NULL;
+		}
+
+		addr_str = g_inet_address_to_string (addr);
+		_LOGD ("resolved VPN gateway '%s' to %s", tmp, addr_str);
+		if (g_inet_address_get_family (addr) == G_SOCKET_FAMILY_IPV4)
+			val = addr4_to_gvariant (addr_str);
+		else
+			val = addr6_to_gvariant (addr_str);
+	} else {
+		val = addr4_to_gvariant (tmp);
+		if (val == NULL) {
+			_LOGW ("failed to convert VPN gateway address '%s' (%d)",
+			       tmp, errno);
+			return NULL;
+		}
+	}
+
+	return val;
+}
+
+/*****************************************************************************/
+
+/**
+ * nmovpn_helper_env_parse:
+ * @env: the environment openvpn passed to the helper
+ * @options: how to interpret it
+ * @out_config: (out): the generic configuration
+ * @out_ip4config: (out): the IPv4 configuration, or %NULL if there is none
+ * @out_ip6config: (out): the IPv6 configuration, or %NULL if there is none
+ * @error: on failure, the message is the name of the missing or invalid
+ *   information, to be passed on to the service with SetFailure.
+ *
+ * Turns the environment into the configuration for the service. Nothing
+ * is sent to it from here.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+nmovpn_helper_env_parse (char **env,
+                         const NMOvpnHelperEnvOptions *options,
+                         GVariant **out_config,
+                         GVariant **out_ip4config,
+                         GVariant **out_ip6config,
+                         GError **error)
+{
+	EnvParser parser_data = { .options = options, };
+	EnvParser *parser = &parser_data;
+	GVariantBuilder builder, ip4builder, ip6builder;
+	GVariant *ip4config, *ip6config;
+	const char *tmp;
+	const char *failed = NULL;
+	GVariant *val;
+	int i;
+	GPtrArray *dns4_list, *dns6_list;
+	GPtrArray *nbns_list;
+	GPtrArray *dns_domains;
+	struct in_addr temp_addr;
+	int tapdev = options->tapdev;
+	gboolean has_ip4_prefix = FALSE;
+	gboolean has_ip4_address = FALSE;
+	gboolean has_ip6_address = FALSE;
+
+	g_return_val_if_fail (out_config, FALSE);
+	g_return_val_if_fail (out_ip4config, FALSE);
+	g_return_val_if_fail (out_ip6config, FALSE);
+
+	env_index_build (parser, env);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_init (&ip4builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_init (&ip6builder, G_VARIANT_TYPE_VARDICT);
+
+	/* External world-visible VPN gateway */
+	val = trusted_remote_to_gvariant (parser);
+	if (val)
+		g_variant_builder_add (&builder, "{sv}", NM_VPN_PLUGIN_CONFIG_EXT_GATEWAY, val);
+	else {
+		failed = "VPN Gateway";
+		goto out_failed;
+	}
+
+	/* Internal VPN subnet gateway */
+	tmp = env_get (parser, ENV_ROUTE_VPN_GATEWAY);
+	val = addr4_to_gvariant (tmp);
+	if (val)
+		g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_INT_GATEWAY, val);
+	else {
+		val = addr6_to_gvariant (tmp);
+		if (val)
+			g_variant_builder_add (&ip6builder, "{sv}", NM_VPN_PLUGIN_IP6_CONFIG_INT_GATEWAY, val);
+	}
+
+	/* VPN device */
+	tmp = env_get (parser, ENV_DEV);
+	val = str_to_gvariant (tmp, FALSE);
+	if (val)
+		g_variant_builder_add (&builder, "{sv}", NM_VPN_PLUGIN_CONFIG_TUNDEV, val);
+	else {
+		failed = "Tunnel Device";
+		goto out_failed;
+	}
+
+	if (tapdev == -1)
+		tapdev = strncmp (tmp, "tap", 3) == 0;
+
+	/* IPv4 address */
+	tmp = env_get (parser, ENV_IFCONFIG_LOCAL);
+	if (!tmp && options->is_restart)
+		tmp = options->restart_local;
+	if (tmp && strlen (tmp)) {
+		val = addr4_to_gvariant (tmp);
+		if (val) {
+			has_ip4_address = TRUE;
+			g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_ADDRESS, val);
+		} else {
+			failed = "IP4 Address";
+			goto out_failed;
+		}
+	}
+
+	/* PTP address; for vpnc PTP address == internal IP4 address */
+	tmp = env_get (parser, ENV_IFCONFIG_REMOTE);
+	if (!tmp && options->is_restart)
+		tmp = options->restart_remote;
+	val = addr4_to_gvariant (tmp);
+	if (val) {
+		/* Sigh.  Openvpn added 'topology' stuff in 2.1 that changes the meaning
+		 * of the ifconfig bits without actually telling you what they are
+		 * supposed to mean; basically relying on specific 'ifconfig' behavior.
+		 */
+		if (tmp && !strncmp (tmp, "255.", 4)) {
+			guint32 addr;
+
+			/* probably a netmask, not a PTP address; topology == subnet */
+			addr = g_variant_get_uint32 (val);
+			g_variant_unref (val);
+			val = g_variant_new_uint32 (nm_utils_ip4_netmask_to_prefix (addr));
+			g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_PREFIX, val);
+			has_ip4_prefix = TRUE;
+		} else
+			g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_PTP, val);
+	}
+
+	/* Netmask
+	 *
+	 * Either TAP or TUN modes can have an arbitrary netmask in newer versions
+	 * of openvpn, while in older versions only TAP mode would.  So accept a
+	 * netmask if passed, otherwise default to /32 for TUN devices since they
+	 * are usually point-to-point.
+	 */
+	tmp = env_get (parser, ENV_IFCONFIG_NETMASK);
+	if (tmp && inet_pton (AF_INET, tmp, &temp_addr) > 0) {
+		val = g_variant_new_uint32 (nm_utils_ip4_netmask_to_prefix (temp_addr.s_addr));
+		g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_PREFIX, val);
+	} else if (!tapdev) {
+		if (has_ip4_address && !has_ip4_prefix) {
+			val = g_variant_new_uint32 (32);
+			g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_PREFIX, val);
+		}
+	} else
+		_LOGW ("No IP4 netmask/prefix (missing or invalid 'ifconfig_netmask')");
+
+	val = get_ip4_routes (parser);
+	if (val && options->is_restart && routes_unchanged (val, options->ip4_routes_digest)) {
+		_LOGD ("IPv4 routes unchanged, preserving them");
+		g_variant_unref (g_variant_ref_sink (val));
+		val = NULL;
+	}
+	if (val)
+		g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_ROUTES, val);
+	else if (options->is_restart) {
+		g_variant_builder_add (&ip4builder, "{sv}",
+		                       NM_VPN_PLUGIN_IP4_CONFIG_PRESERVE_ROUTES,
+		                       g_variant_new_boolean (TRUE));
+	}
+
+	/* IPv6 address */
+	tmp = env_get (parser, ENV_IFCONFIG_IPV6_LOCAL);
+	if (tmp && strlen (tmp)) {
+		val = addr6_to_gvariant (tmp);
+		if (val) {
+			g_variant_builder_add (&ip6builder, "{sv}", NM_VPN_PLUGIN_IP6_CONFIG_ADDRESS, val);
+			has_ip6_address = TRUE;
+		} else {
+			failed = "IP6 Address";
+			goto out_failed;
+		}
+	}
+
+	/* IPv6 remote address */
+	tmp = env_get (parser, ENV_IFCONFIG_IPV6_REMOTE);
+	if (tmp && strlen (tmp)) {
+		val = addr6_to_gvariant (tmp);
+		if (val)
+			g_variant_builder_add (&ip6builder, "{sv}", NM_VPN_PLUGIN_IP6_CONFIG_PTP, val);
+		else {
+			failed = "IP6 PTP Address";
+			goto out_failed;
+		}
+	}
+
+	/* IPv6 netbits */
+	tmp = env_get (parser, ENV_IFCONFIG_IPV6_NETBITS);
+	if (tmp && strlen (tmp)) {
+		long int netbits;
+
+		errno = 0;
+		netbits = strtol (tmp, NULL, 10);
+		if (errno || netbits < 0 || netbits > 128) {
+			_LOGW ("Ignoring invalid prefix '%s'", tmp);
+		} else {
+			val = g_variant_new_uint32 ((guint32) netbits);
+			g_variant_builder_add (&ip6builder, "{sv}", NM_VPN_PLUGIN_IP6_CONFIG_PREFIX, val);
+		}
+	}
+
+	val = get_ip6_routes (parser);
+	if (val && options->is_restart && routes_unchanged (val, options->ip6_routes_digest)) {
+		_LOGD ("IPv6 routes unchanged, preserving them");
+		g_variant_unref (g_variant_ref_sink (val));
+		val = NULL;
+	}
+	if (val)
+		g_variant_builder_add (&ip6builder, "{sv}", NM_VPN_PLUGIN_IP6_CONFIG_ROUTES, val);
+	else if (options->is_restart) {
+		g_variant_builder_add (&ip6builder, "{sv}",
+		                       NM_VPN_PLUGIN_IP6_CONFIG_PRESERVE_ROUTES,
+		                       g_variant_new_boolean (TRUE));
+	}
+
+	/* DNS and WINS servers */
+	dns_domains = g_ptr_array_sized_new (3);
+	dns4_list = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+	dns6_list = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+	nbns_list = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+	for (i = 1; ; i++) {
+		tmp = env_index_get (parser, ENV_FOREIGN_OPTION, i);
+		if (!tmp || strlen (tmp) < 1)
+			break;
+
+		if (!g_str_has_prefix (tmp, "dhcp-option "))
+			continue;
+
+		tmp += 12; /* strlen ("dhcp-option ") */
+
+		if (g_str_has_prefix (tmp, "DNS "))
+			parse_addr_list (dns4_list, dns6_list, tmp + 4);
+		else if (g_str_has_prefix (tmp, "WINS "))
+			parse_addr_list (nbns_list, NULL, tmp + 5);
+		else if (g_str_has_prefix (tmp, "DOMAIN ") && is_domain_valid (tmp + 7))
+			g_ptr_array_add (dns_domains, (gpointer) (tmp + 7));
+	}
+
+	if (dns4_list->len) {
+		val = g_variant_new_array (G_VARIANT_TYPE_UINT32, (GVariant **) dns4_list->pdata, dns4_list->len);
+		g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_DNS, val);
+	}
+
+	if (has_ip6_address && dns6_list->len) {
+		val = g_variant_new_array (G_VARIANT_TYPE ("ay"), (GVariant **) dns6_list->pdata, dns6_list->len);
+		g_variant_builder_add (&ip6builder, "{sv}", NM_VPN_PLUGIN_IP6_CONFIG_DNS, val);
+	}
+
+	if (nbns_list->len) {
+		val = g_variant_new_array (G_VARIANT_TYPE_UINT32, (GVariant **) nbns_list->pdata, nbns_list->len);
+		g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_NBNS, val);
+	}
+
+	if (dns_domains->len) {
+		val = g_variant_new_strv ((const gchar **) dns_domains->pdata, dns_domains->len);
+		g_variant_builder_add (&ip4builder, "{sv}", NM_VPN_PLUGIN_IP4_CONFIG_DOMAINS, val);
+
+		/* Domains apply to both IPv4 and IPv6 configurations */
+		if (has_ip6_address) {
+			val = g_variant_new_strv ((const gchar **) dns_domains->pdata, dns_domains->len);
+			g_variant_builder_add (&ip6builder, "{sv}", NM_VPN_PLUGIN_IP6_CONFIG_DOMAINS, val);
+		}
+	}
+
+	g_ptr_array_unref (dns4_list);
+	g_ptr_array_unref (dns6_list);
+	g_ptr_array_unref (nbns_list);
+	g_ptr_array_unref (dns_domains);
+
+	/* Tunnel MTU */
+	tmp = env_get (parser, ENV_TUN_MTU);
+	if (tmp && strlen (tmp)) {
+		long int mtu;
+
+		errno = 0;
+		mtu = strtol (tmp, NULL, 10);
+		if (errno || mtu < 0 || mtu > 20000) {
+			_LOGW ("Ignoring invalid tunnel MTU '%s'", tmp);
+		} else {
+			val = g_variant_new_uint32 ((guint32) mtu);
+			g_variant_builder_add (&builder, "{sv}", NM_VPN_PLUGIN_CONFIG_MTU, val);
+		}
+	}
+
+	env_index_clear (parser);
+
+	ip4config = g_variant_ref_sink (g_variant_builder_end (&ip4builder));
+
+	if (g_variant_n_children (ip4config)) {
+		val = g_variant_new_boolean (TRUE);
+		g_variant_builder_add (&builder, "{sv}", NM_VPN_PLUGIN_CONFIG_HAS_IP4, val);
+	} else
+		g_clear_pointer (&ip4config, g_variant_unref);
+
+	ip6config = g_variant_ref_sink (g_variant_builder_end (&ip6builder));
+
+	if (g_variant_n_children (ip6config)) {
+		val = g_variant_new_boolean (TRUE);
+		g_variant_builder_add (&builder, "{sv}", NM_VPN_PLUGIN_CONFIG_HAS_IP6, val);
+	} else
+		g_clear_pointer (&ip6config, g_variant_unref);
+
+	if (!ip4config && !ip6config) {
+		g_variant_builder_clear (&builder);
+		g_set_error_literal (error, NM_VPN_PLUGIN_ERROR, NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
+		                     "IPv4 or IPv6 configuration");
+		return FALSE;
+	}
+
+	*out_config = g_variant_ref_sink (g_variant_builder_end (&builder));
+	*out_ip4config = ip4config;
+	*out_ip6config = ip6config;
+	return TRUE;
+
+out_failed:
+	env_index_clear (parser);
+	g_variant_builder_clear (&builder);
+	g_variant_builder_clear (&ip4builder);
+	g_variant_builder_clear (&ip6builder);
+	g_set_error_literal (error, NM_VPN_PLUGIN_ERROR, NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS, failed);
+	return FALSE;
+}
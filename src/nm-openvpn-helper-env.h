@@ -0,0 +1,59 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* nm-openvpn-service-openvpn-helper - parsing of the environment
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NM_OPENVPN_HELPER_ENV_H
+#define NM_OPENVPN_HELPER_ENV_H
+
+#include <gio/gio.h>
+
+typedef void (*NMOvpnHelperEnvLogFunc) (int level, const char *msg, gpointer user_data);
+
+typedef struct {
+	/* -1 to guess from the name of the device, 0 for tun, 1 for tap. */
+	int tapdev;
+
+	gboolean aggregate_routes;
+
+	/* openvpn calls the helper again on a restart, with the local and
+	 * remote address on the command line. */
+	gboolean is_restart;
+	const char *restart_local;
+	const char *restart_remote;
+
+	/* the digests of the routes passed to the service last time. Routes
+	 * that didn't change are preserved instead of being set again. */
+	const char *ip4_routes_digest;
+	const char *ip6_routes_digest;
+
+	/* used to look up the gateway if openvpn only passed its name. With
+	 * %NULL, names are not looked up. */
+	GResolver *resolver;
+
+	int log_level;
+	NMOvpnHelperEnvLogFunc log_func;
+	gpointer log_user_data;
+} NMOvpnHelperEnvOptions;
+
+gboolean nmovpn_helper_env_parse (char **env,
+                                  const NMOvpnHelperEnvOptions *options,
+                                  GVariant **out_config,
+                                  GVariant **out_ip4config,
+                                  GVariant **out_ip6config,
+                                  GError **error);
+
+#endif /* NM_OPENVPN_HELPER_ENV_H */
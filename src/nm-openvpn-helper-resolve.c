@@ -0,0 +1,117 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* nm-openvpn-service-openvpn-helper - gateway resolution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "nm-default.h"
+
+#include "nm-openvpn-helper-resolve.h"
+
+/*****************************************************************************/
+
+typedef struct {
+	GList *addresses;
+	GError *error;
+	gboolean done;
+	gboolean timed_out;
+	GCancellable *cancellable;
+} ResolveData;
+
+static void
+_resolve_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	ResolveData *data = user_data;
+
+	data->addresses = g_resolver_lookup_by_name_finish (G_RESOLVER (source), result, &data->error);
+	data->done = TRUE;
+}
+
+static gboolean
+_resolve_timeout_cb (gpointer user_data)
+{
+	ResolveData *data = user_data;
+
+	data->timed_out = TRUE;
+	g_cancellable_cancel (data->cancellable);
+	return G_SOURCE_REMOVE;
+}
+
+/* Looks up the IPv4 and IPv6 addresses of @host, giving up after
+ * @timeout_msec. An IPv4 address is preferred, as openvpn does by
+ * default.
+ *
+ * openvpn is waiting for us while we resolve, so we must not block
+ * for a full DNS timeout. The lookup runs asynchronously in its own
+ * main context, so that no other sources get dispatched meanwhile. */
+GInetAddress *
+nmovpn_resolve_remote (GResolver *resolver,
+                       const char *host,
+                       guint timeout_msec,
+                       GError **error)
+{
+	ResolveData data = { 0, };
+	GMainContext *context;
+	GSource *timeout;
+	GInetAddress *found = NULL;
+	GList *iter;
+
+	g_return_val_if_fail (G_IS_RESOLVER (resolver), NULL);
+	g_return_val_if_fail (host, NULL);
+
+	context = g_main_context_new ();
+	g_main_context_push_thread_default (context);
+
+	data.cancellable = g_cancellable_new ();
+
+	timeout = g_timeout_source_new (timeout_msec);
+	g_source_set_callback (timeout, _resolve_timeout_cb, &data, NULL);
+	g_source_attach (timeout, context);
+
+	g_resolver_lookup_by_name_async (resolver, host, data.cancellable, _resolve_cb, &data);
+
+	while (!data.done)
+		g_main_context_iteration (context, TRUE);
+
+	g_source_destroy (timeout);
+	g_source_unref (timeout);
+	g_object_unref (data.cancellable);
+
+	g_main_context_pop_thread_default (context);
+	g_main_context_unref (context);
+
+	if (!data.addresses) {
+		if (data.timed_out) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+			             "timed out after %u msec", timeout_msec);
+			g_clear_error (&data.error);
+		} else
+			g_propagate_error (error, data.error);
+		return NULL;
+	}
+
+	for (iter = data.addresses; iter; iter = iter->next) {
+		if (g_inet_address_get_family (iter->data) == G_SOCKET_FAMILY_IPV4) {
+			found = iter->data;
+			break;
+		}
+	}
+	if (!found)
+		found = data.addresses->data;
+
+	g_object_ref (found);
+	g_resolver_free_addresses (data.addresses);
+	return found;
+}
@@ -0,0 +1,497 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* nm-openvpn-service-openvpn-helper - route handling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "nm-default.h"
+
+#include "nm-openvpn-helper-routes.h"
+
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Servers may push tens of thousands of routes. Building the route
+ * variants with GVariantBuilder costs several allocations per route, so
+ * instead we write the serialized form of the whole table into a single
+ * buffer and hand that to g_variant_new_from_data().
+ *
+ * See the GVariant specification, or gvariant-serialiser.c in glib, for
+ * the serialization format:
+ *  - fixed size values are stored in native byte order, aligned to
+ *    their alignment,
+ *  - arrays and structures with non fixed size members are followed by
+ *    framing offsets, which are stored in little endian. Their size
+ *    depends on the total size of the container.
+ */
+
+static gsize
+_framing_offset_size (gsize body_size, gsize n_offsets)
+{
+	if (body_size + 1 * n_offsets <= G_MAXUINT8)
+		return 1;
+	if (body_size + 2 * n_offsets <= G_MAXUINT16)
+		return 2;
+	if (body_size + 4 * n_offsets <= G_MAXUINT32)
+		return 4;
+	return 8;
+}
+
+static void
+_framing_offset_write (guint8 *dst, gsize offset, gsize offset_size)
+{
+	gsize i;
+
+	for (i = 0; i < offset_size; i++) {
+		dst[i] = offset & 0xFF;
+		offset >>= 8;
+	}
+}
+
+/* An IPv4 route is an "au" with 4 elements: network, prefix, gateway and metric. */
+#define IP4_ROUTE_SIZE (4 * sizeof (guint32))
+
+GVariant *
+nmovpn_ip4_routes_to_variant (const NMOvpnIP4Route *routes, gsize n_routes)
+{
+	gsize body_size, offset_size, i;
+	guint8 *data;
+
+	if (!n_routes)
+		return g_variant_new_array (G_VARIANT_TYPE ("au"), NULL, 0);
+
+	body_size = n_routes * IP4_ROUTE_SIZE;
+	offset_size = _framing_offset_size (body_size, n_routes);
+	data = g_malloc (body_size + n_routes * offset_size);
+
+	for (i = 0; i < n_routes; i++) {
+		const guint32 elem[4] = {
+			routes[i].network,
+			routes[i].prefix,
+			routes[i].gateway,
+			routes[i].metric,
+		};
+
+		memcpy (&data[i * IP4_ROUTE_SIZE], elem, IP4_ROUTE_SIZE);
+		_framing_offset_write (&data[body_size + i * offset_size],
+		                       (i + 1) * IP4_ROUTE_SIZE,
+		                       offset_size);
+	}
+
+	return g_variant_new_from_data (G_VARIANT_TYPE ("aau"),
+	                                data, body_size + n_routes * offset_size,
+	                                TRUE, g_free, data);
+}
+
+/* An IPv6 route is a "(ayuayu)": network, prefix, gateway and metric.
+ *
+ * The two "ay" have a framing offset each, which in a structure of this
+ * size takes a single byte. They are stored in reverse order after the
+ * last member. The structure is aligned to 4 bytes, so in the array each
+ * route is followed by 2 bytes of padding, except for the last one. */
+#define IP6_ROUTE_BODY_SIZE   (16 + 4 + 16 + 4)
+#define IP6_ROUTE_SIZE        (IP6_ROUTE_BODY_SIZE + 2)
+#define IP6_ROUTE_STRIDE      (IP6_ROUTE_SIZE + 2)
+
+GVariant *
+nmovpn_ip6_routes_to_variant (const NMOvpnIP6Route *routes, gsize n_routes)
+{
+	gsize body_size, offset_size, i;
+	guint8 *data;
+
+	if (!n_routes)
+		return g_variant_new_array (G_VARIANT_TYPE ("(ayuayu)"), NULL, 0);
+
+	body_size = (n_routes - 1) * IP6_ROUTE_STRIDE + IP6_ROUTE_SIZE;
+	offset_size = _framing_offset_size (body_size, n_routes);
+	data = g_malloc0 (body_size + n_routes * offset_size);
+
+	for (i = 0; i < n_routes; i++) {
+		guint8 *elem = &data[i * IP6_ROUTE_STRIDE];
+
+		memcpy (&elem[0], &routes[i].network, 16);
+		memcpy (&elem[16], &routes[i].prefix, 4);
+		memcpy (&elem[20], &routes[i].gateway, 16);
+		memcpy (&elem[36], &routes[i].metric, 4);
+		elem[IP6_ROUTE_BODY_SIZE] = 36;
+		elem[IP6_ROUTE_BODY_SIZE + 1] = 16;
+
+		_framing_offset_write (&data[body_size + i * offset_size],
+		                       i * IP6_ROUTE_STRIDE + IP6_ROUTE_SIZE,
+		                       offset_size);
+	}
+
+	return g_variant_new_from_data (G_VARIANT_TYPE ("a(ayuayu)"),
+	                                data, body_size + n_routes * offset_size,
+	                                TRUE, g_free, data);
+}
+
+/*****************************************************************************/
+
+/* Route aggregation.
+ *
+ * The routes are put into a path compressed binary trie (a patricia
+ * trie) over the destination prefix. Walking the trie bottom-up we then
+ *  - drop routes that are contained in a shorter route with the same
+ *    gateway and metric, as the shorter one already forwards all their
+ *    destinations the same way,
+ *  - replace two sibling prefixes, which together cover their parent
+ *    prefix, by the parent prefix if they have the same gateway and
+ *    metric. This repeats upwards as far as possible.
+ *
+ * When several routes with different gateway or metric share the same
+ * prefix, they are all kept and nothing below or above them is merged
+ * across them. Routes are never merged into a default route, as the
+ * server pushing 0.0.0.0/1 and 128.0.0.0/1 ("def1") explicitly wants to
+ * override the default route instead of replacing it. */
+
+typedef struct {
+	guint8 network[16];
+	guint8 gateway[16];
+	guint32 prefix;
+	guint32 metric;
+} AggRoute;
+
+typedef struct {
+	guint8 network[16];
+	guint32 prefix;
+	guint child[2];
+	/* index of the first route with this prefix, or -1. More routes
+	 * with the same prefix but another gateway or metric are chained
+	 * in AggTrie.next. */
+	gssize route;
+} AggNode;
+
+typedef struct {
+	const AggRoute *routes;
+	gssize *next;
+	GArray *nodes;
+	AggRoute *result;
+	gsize n_result;
+} AggTrie;
+
+/* return values of _agg_walk() and the context of a node, besides the
+ * index of a route whose gateway and metric cover the whole node. */
+#define AGG_NONE     ((gssize) -1)  /* nothing covers the prefix */
+#define AGG_HANDLED  ((gssize) -2)  /* the subtree was already emitted */
+#define AGG_BARRIER  ((gssize) -3)  /* there are several routes for the prefix */
+
+#define _agg_node(trie, idx) (&g_array_index ((trie)->nodes, AggNode, (idx)))
+
+static inline guint
+_agg_bit (const guint8 *addr, guint32 bit)
+{
+	return (addr[bit / 8] >> (7 - (bit % 8))) & 1;
+}
+
+static void
+_agg_mask (guint8 *dst, const guint8 *src, guint32 prefix)
+{
+	guint32 n = prefix / 8;
+
+	memset (dst, 0, 16);
+	memcpy (dst, src, n);
+	if (prefix % 8)
+		dst[n] = src[n] & (0xFF << (8 - (prefix % 8)));
+}
+
+static guint32
+_agg_common_prefix (const guint8 *a, const guint8 *b, guint32 max)
+{
+	guint32 i = 0;
+
+	while (i + 8 <= max && a[i / 8] == b[i / 8])
+		i += 8;
+	while (i < max && _agg_bit (a, i) == _agg_bit (b, i))
+		i++;
+	return i;
+}
+
+static gboolean
+_agg_same_nexthop (const AggTrie *trie, gssize a, gssize b)
+{
+	if (a < 0 || b < 0)
+		return FALSE;
+	return    trie->routes[a].metric == trie->routes[b].metric
+	       && memcmp (trie->routes[a].gateway, trie->routes[b].gateway, 16) == 0;
+}
+
+static guint
+_agg_node_new (AggTrie *trie, const guint8 *network, guint32 prefix)
+{
+	AggNode *node;
+
+	g_array_set_size (trie->nodes, trie->nodes->len + 1);
+	node = _agg_node (trie, trie->nodes->len - 1);
+	_agg_mask (node->network, network, prefix);
+	node->prefix = prefix;
+	node->child[0] = 0;
+	node->child[1] = 0;
+	node->route = AGG_NONE;
+	return trie->nodes->len - 1;
+}
+
+static void
+_agg_node_add_route (AggTrie *trie, guint idx, gssize route)
+{
+	AggNode *node = _agg_node (trie, idx);
+	gssize r;
+
+	for (r = node->route; r >= 0; r = trie->next[r]) {
+		/* drop duplicates */
+		if (_agg_same_nexthop (trie, r, route))
+			return;
+	}
+	trie->next[route] = node->route;
+	node->route = route;
+}
+
+static void
+_agg_insert (AggTrie *trie, gssize route)
+{
+	const guint8 *network = trie->routes[route].network;
+	guint32 prefix = trie->routes[route].prefix;
+	guint idx = 0;
+
+	for (;;) {
+		AggNode *node = _agg_node (trie, idx);
+		guint32 common;
+		guint child, bit, n;
+
+		if (node->prefix == prefix) {
+			_agg_node_add_route (trie, idx, route);
+			return;
+		}
+
+		bit = _agg_bit (network, node->prefix);
+		child = node->child[bit];
+		if (!child) {
+			n = _agg_node_new (trie, network, prefix);
+			_agg_node (trie, idx)->child[bit] = n;
+			_agg_node_add_route (trie, n, route);
+			return;
+		}
+
+		common = _agg_common_prefix (network,
+		                             _agg_node (trie, child)->network,
+		                             MIN (prefix, _agg_node (trie, child)->prefix));
+		if (common == _agg_node (trie, child)->prefix) {
+			idx = child;
+			continue;
+		}
+
+		/* split the edge to the child at the common prefix */
+		n = _agg_node_new (trie, network, common);
+		_agg_node (trie, n)->child[_agg_bit (_agg_node (trie, child)->network, common)] = child;
+		_agg_node (trie, idx)->child[bit] = n;
+		if (common == prefix)
+			_agg_node_add_route (trie, n, route);
+		else
+			idx = n;
+	}
+}
+
+static void
+_agg_emit (AggTrie *trie, guint idx, gssize route)
+{
+	const AggNode *node = _agg_node (trie, idx);
+	AggRoute *r = &trie->result[trie->n_result++];
+
+	*r = trie->routes[route];
+	memcpy (r->network, node->network, 16);
+	r->prefix = node->prefix;
+}
+
+static gssize
+_agg_walk (AggTrie *trie, guint idx, gssize ctx)
+{
+	const AggNode *node = _agg_node (trie, idx);
+	gssize own, child_ctx;
+	gssize half[2];
+	guint child[2];
+	guint i;
+
+	child[0] = node->child[0];
+	child[1] = node->child[1];
+
+	own = node->route;
+	if (own >= 0 && trie->next[own] >= 0)
+		child_ctx = AGG_BARRIER;
+	else if (own >= 0)
+		child_ctx = own;
+	else
+		child_ctx = ctx;
+
+	for (i = 0; i < 2; i++) {
+		const AggNode *c;
+		gssize u;
+
+		half[i] = AGG_NONE;
+		if (!child[i])
+			continue;
+
+		u = _agg_walk (trie, child[i], child_ctx);
+		c = _agg_node (trie, child[i]);
+		node = _agg_node (trie, idx);
+
+		if (u < 0)
+			half[i] = AGG_HANDLED;
+		else if (c->prefix == node->prefix + 1)
+			half[i] = u;
+		else if (_agg_same_nexthop (trie, u, child_ctx)) {
+			/* the child only covers part of this half, but it is
+			 * redundant anyway. */
+		} else {
+			_agg_emit (trie, child[i], u);
+			half[i] = AGG_HANDLED;
+		}
+	}
+
+	if (child_ctx == AGG_BARRIER) {
+		gssize r;
+
+		for (r = own; r >= 0; r = trie->next[r])
+			_agg_emit (trie, idx, r);
+		for (i = 0; i < 2; i++) {
+			if (half[i] >= 0)
+				_agg_emit (trie, child[i], half[i]);
+		}
+		return AGG_HANDLED;
+	}
+
+	if (own >= 0) {
+		gboolean uniform = TRUE;
+
+		for (i = 0; i < 2; i++) {
+			if (half[i] == AGG_NONE || _agg_same_nexthop (trie, half[i], own))
+				continue;
+			uniform = FALSE;
+		}
+		if (uniform)
+			return own;
+
+		for (i = 0; i < 2; i++) {
+			if (half[i] >= 0 && !_agg_same_nexthop (trie, half[i], own))
+				_agg_emit (trie, child[i], half[i]);
+		}
+		if (!_agg_same_nexthop (trie, own, ctx))
+			_agg_emit (trie, idx, own);
+		return AGG_HANDLED;
+	}
+
+	/* merge siblings, but never into a default route. */
+	if (   node->prefix > 0
+	    && _agg_same_nexthop (trie, half[0], half[1]))
+		return half[0];
+
+	for (i = 0; i < 2; i++) {
+		if (half[i] >= 0 && !_agg_same_nexthop (trie, half[i], ctx))
+			_agg_emit (trie, child[i], half[i]);
+	}
+	return AGG_HANDLED;
+}
+
+/* Aggregates @routes in place and returns the new number of routes. */
+static gsize
+_agg_routes (AggRoute *routes, gsize n_routes, guint32 max_prefix)
+{
+	AggTrie trie = { 0, };
+	gs_free AggRoute *result = NULL;
+	gsize i;
+	gssize u;
+
+	if (n_routes < 2)
+		return n_routes;
+
+	trie.routes = routes;
+	trie.next = g_new (gssize, n_routes);
+	trie.nodes = g_array_sized_new (FALSE, FALSE, sizeof (AggNode), 2 * n_routes + 1);
+	trie.result = result = g_new (AggRoute, n_routes);
+
+	_agg_node_new (&trie, routes[0].network, 0);
+	for (i = 0; i < n_routes; i++) {
+		if (routes[i].prefix > max_prefix)
+			routes[i].prefix = max_prefix;
+		_agg_insert (&trie, i);
+	}
+
+	u = _agg_walk (&trie, 0, AGG_NONE);
+	if (u >= 0)
+		_agg_emit (&trie, 0, u);
+
+	g_assert (trie.n_result <= n_routes);
+	memcpy (routes, result, trie.n_result * sizeof (AggRoute));
+
+	g_free (trie.next);
+	g_array_unref (trie.nodes);
+	return trie.n_result;
+}
+
+gsize
+nmovpn_ip4_routes_aggregate (NMOvpnIP4Route *routes, gsize n_routes)
+{
+	gs_free AggRoute *agg = NULL;
+	gsize i, n;
+
+	if (n_routes < 2)
+		return n_routes;
+
+	agg = g_new0 (AggRoute, n_routes);
+	for (i = 0; i < n_routes; i++) {
+		memcpy (agg[i].network, &routes[i].network, 4);
+		memcpy (agg[i].gateway, &routes[i].gateway, 4);
+		agg[i].prefix = routes[i].prefix;
+		agg[i].metric = routes[i].metric;
+	}
+
+	n = _agg_routes (agg, n_routes, 32);
+
+	for (i = 0; i < n; i++) {
+		memcpy (&routes[i].network, agg[i].network, 4);
+		memcpy (&routes[i].gateway, agg[i].gateway, 4);
+		routes[i].prefix = agg[i].prefix;
+		routes[i].metric = agg[i].metric;
+	}
+	return n;
+}
+
+gsize
+nmovpn_ip6_routes_aggregate (NMOvpnIP6Route *routes, gsize n_routes)
+{
+	gs_free AggRoute *agg = NULL;
+	gsize i, n;
+
+	if (n_routes < 2)
+		return n_routes;
+
+	agg = g_new (AggRoute, n_routes);
+	for (i = 0; i < n_routes; i++) {
+		memcpy (agg[i].network, &routes[i].network, 16);
+		memcpy (agg[i].gateway, &routes[i].gateway, 16);
+		agg[i].prefix = routes[i].prefix;
+		agg[i].metric = routes[i].metric;
+	}
+
+	n = _agg_routes (agg, n_routes, 128);
+
+	for (i = 0; i < n; i++) {
+		memcpy (&routes[i].network, agg[i].network, 16);
+		memcpy (&routes[i].gateway, agg[i].gateway, 16);
+		routes[i].prefix = agg[i].prefix;
+		routes[i].metric = agg[i].metric;
+	}
+	return n;
+}
@@ -0,0 +1,44 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* nm-openvpn-service-openvpn-helper - route handling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NM_OPENVPN_HELPER_ROUTES_H
+#define NM_OPENVPN_HELPER_ROUTES_H
+
+#include <netinet/in.h>
+
+typedef struct {
+	guint32 network;  /* in network byte order */
+	guint32 prefix;
+	guint32 gateway;  /* in network byte order, 0 if there is none */
+	guint32 metric;
+} NMOvpnIP4Route;
+
+typedef struct {
+	struct in6_addr network;
+	guint32 prefix;
+	struct in6_addr gateway;  /* :: if there is none */
+	guint32 metric;
+} NMOvpnIP6Route;
+
+GVariant *nmovpn_ip4_routes_to_variant (const NMOvpnIP4Route *routes, gsize n_routes);
+GVariant *nmovpn_ip6_routes_to_variant (const NMOvpnIP6Route *routes, gsize n_routes);
+
+gsize nmovpn_ip4_routes_aggregate (NMOvpnIP4Route *routes, gsize n_routes);
+gsize nmovpn_ip6_routes_aggregate (NMOvpnIP6Route *routes, gsize n_routes);
+
+#endif /* NM_OPENVPN_HELPER_ROUTES_H */
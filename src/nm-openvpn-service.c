@@ -47,6 +47,7 @@
 #include <glib-unix.h>
 
 #include "utils.h"
+#include "openvpn-binary.h"
 #include "nm-utils/nm-shared-utils.h"
 #include "nm-utils/nm-vpn-plugin-macros.h"
 
@@ -56,16 +57,44 @@
 
 #define RUNDIR  LOCALSTATEDIR"/run/NetworkManager"
 
+/* How long to wait for openvpn to connect to our management socket. */
+#define MGT_ATTACH_TIMEOUT_MSEC 6000
+
+/* Upper bounds (in milliseconds) of the buckets of the management socket
+ * attach latency histogram. There is one more, open ended, bucket. */
+static const guint mgt_attach_hist_msec[] = { 5, 10, 25, 50, 100, 250, 500, 1000, 2500 };
+
 static struct {
 	gboolean debug;
 	int log_level;
 	int log_level_ovpn;
 	bool log_syslog;
 	GSList *pids_pending_list;
+	guint mgt_attach_hist[G_N_ELEMENTS (mgt_attach_hist_msec) + 1];
+	guint n_io_data;
+	struct {
+		gint64 timestamp;
+		const char *user;
+		const char *group;
+		const char *chroot;
+		bool user_found;
+		bool group_found;
+		bool chroot_usable;
+	} run_as;
 } gl/*obal*/;
 
 #define NM_OPENVPN_HELPER_PATH LIBEXECDIR"/nm-openvpn-service-openvpn-helper"
 
+/* The paths can be overridden from the environment, so that the tests
+ * can run the service against a stand-in for openvpn. */
+static const char *
+getenv_path (const char *name, const char *default_path)
+{
+	const char *path = getenv (name);
+
+	return path && path[0] ? path : default_path;
+}
+
 G_DEFINE_TYPE (NMOpenvpnPlugin, nm_openvpn_plugin, NM_TYPE_VPN_SERVICE_PLUGIN)
 
 #define NM_OPENVPN_PLUGIN_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_OPENVPN_PLUGIN, NMOpenvpnPluginPrivate))
@@ -80,25 +109,56 @@ typedef struct {
 	char *pending_auth;
 	GIOChannel *socket_channel;
 	guint socket_channel_eventid;
+	GString *read_buf;
 } NMOpenvpnPluginIOData;
 
+typedef struct {
+	gint64 timestamp;
+	guint64 bytes_in;
+	guint64 bytes_out;
+} BytecountSample;
+
+typedef struct {
+	const char *name;
+	gint64 begin;
+	gint64 end;
+} TraceSpan;
+
 typedef struct {
 	GPid pid;
 	guint connect_timer;
-	guint connect_count;
 	NMOpenvpnPluginIOData *io_data;
 	gboolean interactive;
 	char *mgt_path;
+	GIOChannel *mgt_listen_channel;
+	guint mgt_listen_id;
+	gint64 mgt_attach_start;
+	GDBusConnection *dbus_connection;
+	guint dbus_registration_id;
+	struct {
+		/* from the connection, in seconds. An interval of 0 disables it. */
+		guint interval;
+		guint window;
+		guint64 bytes_in;
+		guint64 bytes_out;
+		/* ring buffer with the samples of the aggregation window */
+		BytecountSample *samples;
+		guint n_samples;
+		guint len;
+		guint head;
+	} bytecount;
+	struct {
+		char *uuid;
+		gint64 start;
+		GArray *spans;
+	} trace;
+	/* digests of the routes last handed over by the helper script */
+	char *ip4_routes_digest;
+	char *ip6_routes_digest;
+	/* connection UUID -> ArgvTemplate */
+	GHashTable *argv_templates;
 } NMOpenvpnPluginPrivate;
 
-typedef struct {
-	const char *name;
-	GType type;
-	gint int_min;
-	gint int_max;
-	gboolean address;
-} ValidProperty;
-
 typedef struct {
 	GPid pid;
 	guint watch_id;
@@ -106,63 +166,13 @@ typedef struct {
 	NMOpenvpnPlugin *plugin;
 } PidsPendingData;
 
-static ValidProperty valid_properties[] = {
-	{ NM_OPENVPN_KEY_AUTH,                 G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_CA,                   G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_CERT,                 G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_CIPHER,               G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_KEYSIZE,              G_TYPE_INT, 1, 65535, FALSE },
-	{ NM_OPENVPN_KEY_COMP_LZO,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_CONNECTION_TYPE,      G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_FLOAT,                G_TYPE_BOOLEAN, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_FRAGMENT_SIZE,        G_TYPE_INT, 0, G_MAXINT, FALSE },
-	{ NM_OPENVPN_KEY_KEY,                  G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_LOCAL_IP,             G_TYPE_STRING, 0, 0, TRUE },
-	{ NM_OPENVPN_KEY_MSSFIX,               G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_PING,                 G_TYPE_INT, 0, G_MAXINT, FALSE },
-	{ NM_OPENVPN_KEY_PING_EXIT,            G_TYPE_INT, 0, G_MAXINT, FALSE },
-	{ NM_OPENVPN_KEY_PING_RESTART,         G_TYPE_INT, 0, G_MAXINT, FALSE },
-	{ NM_OPENVPN_KEY_MAX_ROUTES,           G_TYPE_INT, 0, 100000000, FALSE },
-	{ NM_OPENVPN_KEY_PROTO_TCP,            G_TYPE_BOOLEAN, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_PORT,                 G_TYPE_INT, 1, 65535, FALSE },
-	{ NM_OPENVPN_KEY_PROXY_TYPE,           G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_PROXY_SERVER,         G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_PROXY_PORT,           G_TYPE_INT, 1, 65535, FALSE },
-	{ NM_OPENVPN_KEY_PROXY_RETRY,          G_TYPE_BOOLEAN, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_HTTP_PROXY_USERNAME,  G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_REMOTE,               G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_REMOTE_RANDOM,        G_TYPE_BOOLEAN, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_REMOTE_IP,            G_TYPE_STRING, 0, 0, TRUE },
-	{ NM_OPENVPN_KEY_RENEG_SECONDS,        G_TYPE_INT, 0, G_MAXINT, FALSE },
-	{ NM_OPENVPN_KEY_STATIC_KEY,           G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_STATIC_KEY_DIRECTION, G_TYPE_INT, 0, 1, FALSE },
-	{ NM_OPENVPN_KEY_TA,                   G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_TA_DIR,               G_TYPE_INT, 0, 1, FALSE },
-	{ NM_OPENVPN_KEY_TAP_DEV,              G_TYPE_BOOLEAN, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_DEV,                  G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_DEV_TYPE,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_TUN_IPV6,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_TLS_CIPHER,           G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_TLS_REMOTE,           G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_VERIFY_X509_NAME,     G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_REMOTE_CERT_TLS,      G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_NS_CERT_TYPE,         G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_TUNNEL_MTU,           G_TYPE_INT, 0, G_MAXINT, FALSE },
-	{ NM_OPENVPN_KEY_USERNAME,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_PASSWORD"-flags",     G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_CERTPASS"-flags",     G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_NOSECRET,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_HTTP_PROXY_PASSWORD"-flags", G_TYPE_STRING, 0, 0, FALSE },
-	{ NULL,                                G_TYPE_NONE, FALSE }
-};
-
-static ValidProperty valid_secrets[] = {
-	{ NM_OPENVPN_KEY_PASSWORD,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_CERTPASS,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_NOSECRET,             G_TYPE_STRING, 0, 0, FALSE },
-	{ NM_OPENVPN_KEY_HTTP_PROXY_PASSWORD,  G_TYPE_STRING, 0, 0, FALSE },
-	{ NULL,                                G_TYPE_NONE, FALSE }
-};
+typedef struct {
+	char *fingerprint;
+	/* argv[mgt_path_idx] is a placeholder for the management socket */
+	char **argv;
+	guint mgt_path_idx;
+	gboolean use_mgt_socket;
+} ArgvTemplate;
 
 /*****************************************************************************/
 
@@ -188,6 +198,132 @@ _LOGD_enabled (void)
 
 /*****************************************************************************/
 
+/* The connect tracer records when the stages of a connection attempt
+ * begin and end, so that slow connects can be attributed to a stage. The
+ * trace is logged when the connection goes down. */
+
+#define TRACE_SPAN_NONE G_MAXUINT
+
+static void
+trace_clear (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	nm_clear_g_free (&priv->trace.uuid);
+	if (priv->trace.spans)
+		g_array_set_size (priv->trace.spans, 0);
+}
+
+static void
+trace_begin (NMOpenvpnPlugin *plugin, NMConnection *connection)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	const char *uuid = nm_connection_get_uuid (connection);
+
+	/* NeedSecrets and Connect belong to the same attempt. */
+	if (priv->trace.uuid && nm_streq0 (priv->trace.uuid, uuid))
+		return;
+
+	trace_clear (plugin);
+	if (!priv->trace.spans)
+		priv->trace.spans = g_array_new (FALSE, FALSE, sizeof (TraceSpan));
+	priv->trace.uuid = g_strdup (uuid ?: "");
+	priv->trace.start = g_get_monotonic_time ();
+}
+
+static guint
+trace_span_begin (NMOpenvpnPlugin *plugin, const char *name)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	TraceSpan span = { name, g_get_monotonic_time (), 0 };
+
+	if (!priv->trace.uuid)
+		return TRACE_SPAN_NONE;
+
+	g_array_append_val (priv->trace.spans, span);
+	return priv->trace.spans->len - 1;
+}
+
+static void
+trace_span_end (NMOpenvpnPlugin *plugin, guint idx)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	if (   idx == TRACE_SPAN_NONE
+	    || !priv->trace.uuid
+	    || idx >= priv->trace.spans->len)
+		return;
+
+	g_array_index (priv->trace.spans, TraceSpan, idx).end = g_get_monotonic_time ();
+}
+
+/* A span that started at @begin and ends now. */
+static void
+trace_span_add (NMOpenvpnPlugin *plugin, const char *name, gint64 begin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	TraceSpan span = { name, begin, g_get_monotonic_time () };
+
+	if (priv->trace.uuid)
+		g_array_append_val (priv->trace.spans, span);
+}
+
+static void
+trace_event (NMOpenvpnPlugin *plugin, const char *name)
+{
+	trace_span_end (plugin, trace_span_begin (plugin, name));
+}
+
+static void
+trace_event_once (NMOpenvpnPlugin *plugin, const char *name)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	guint i;
+
+	if (!priv->trace.uuid)
+		return;
+	for (i = 0; i < priv->trace.spans->len; i++) {
+		if (nm_streq (g_array_index (priv->trace.spans, TraceSpan, i).name, name))
+			return;
+	}
+	trace_event (plugin, name);
+}
+
+static void
+trace_dump (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	GString *str;
+	guint i;
+
+	if (!priv->trace.uuid)
+		return;
+
+	/* one line of JSON, times are in microseconds since the start of the trace. */
+	str = g_string_sized_new (256);
+	g_string_append_printf (str, "{\"uuid\":\"%s\",\"spans\":[", priv->trace.uuid);
+	for (i = 0; i < priv->trace.spans->len; i++) {
+		const TraceSpan *span = &g_array_index (priv->trace.spans, TraceSpan, i);
+
+		g_string_append_printf (str, "%s{\"name\":\"%s\",\"begin\":%"G_GINT64_FORMAT",\"end\":",
+		                        i ? "," : "",
+		                        span->name,
+		                        span->begin - priv->trace.start);
+		if (span->end)
+			g_string_append_printf (str, "%"G_GINT64_FORMAT"}", span->end - priv->trace.start);
+		else
+			g_string_append (str, "null}");
+	}
+	g_string_append (str, "]}");
+
+	_LOGI ("connect trace: %s", str->str);
+	g_string_free (str, TRUE);
+
+	trace_clear (plugin);
+}
+
+/*****************************************************************************/
+
 static void
 pids_pending_data_free (PidsPendingData *pid_data)
 {
@@ -211,6 +347,8 @@ pids_pending_get (GPid pid)
 }
 
 static void openvpn_child_terminated (NMOpenvpnPlugin *plugin, GPid pid, gint status);
+static void nm_openvpn_plugin_export (NMOpenvpnPlugin *plugin);
+static void nm_openvpn_plugin_unexport (NMOpenvpnPlugin *plugin);
 
 static void
 pids_pending_child_watch_cb (GPid pid, gint status, gpointer user_data)
@@ -328,7 +466,7 @@ validate_address (const char *address)
 }
 
 typedef struct ValidateInfo {
-	ValidProperty *table;
+	NMVPropertyFlags flags;
 	GError **error;
 	gboolean have_items;
 } ValidateInfo;
@@ -337,7 +475,8 @@ static void
 validate_one_property (const char *key, const char *value, gpointer user_data)
 {
 	ValidateInfo *info = (ValidateInfo *) user_data;
-	int i;
+	const NMVPropertyInfo *prop;
+	long int tmp;
 
 	if (*(info->error))
 		return;
@@ -348,64 +487,58 @@ validate_one_property (const char *key, const char *value, gpointer user_data)
 	if (!strcmp (key, NM_SETTING_NAME))
 		return;
 
-	for (i = 0; info->table[i].name; i++) {
-		ValidProperty prop = info->table[i];
-		long int tmp;
-
-		if (strcmp (prop.name, key))
-			continue;
-
-		switch (prop.type) {
-		case G_TYPE_STRING:
-			if (!prop.address || validate_address (value))
-				return; /* valid */
+	prop = nmv_property_info_lookup (key);
+	if (!prop || !NM_FLAGS_ANY (prop->flags, info->flags)) {
+		g_set_error (info->error,
+		             NM_VPN_PLUGIN_ERROR,
+		             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
+		             _("property “%s” invalid or not supported"),
+		             key);
+		return;
+	}
 
-			g_set_error (info->error,
-			             NM_VPN_PLUGIN_ERROR,
-			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
-			             _("invalid address “%s”"),
-			             key);
-			break;
-		case G_TYPE_INT:
-			errno = 0;
-			tmp = strtol (value, NULL, 10);
-			if (errno == 0 && tmp >= prop.int_min && tmp <= prop.int_max)
-				return; /* valid */
+	switch (prop->type) {
+	case G_TYPE_STRING:
+		if (   !NM_FLAGS_HAS (prop->flags, NMV_PROPERTY_FLAG_ADDRESS)
+		    || validate_address (value))
+			return; /* valid */
 
-			g_set_error (info->error,
-			             NM_VPN_PLUGIN_ERROR,
-			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
-			             _("invalid integer property “%s” or out of range [%d -> %d]"),
-			             key, prop.int_min, prop.int_max);
-			break;
-		case G_TYPE_BOOLEAN:
-			if (!strcmp (value, "yes") || !strcmp (value, "no"))
-				return; /* valid */
+		g_set_error (info->error,
+		             NM_VPN_PLUGIN_ERROR,
+		             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
+		             _("invalid address “%s”"),
+		             key);
+		break;
+	case G_TYPE_INT:
+		errno = 0;
+		tmp = strtol (value, NULL, 10);
+		if (errno == 0 && tmp >= prop->int_min && tmp <= prop->int_max)
+			return; /* valid */
 
-			g_set_error (info->error,
-			             NM_VPN_PLUGIN_ERROR,
-			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
-			             /* Translators: keep "yes" and "no" untranslated! */
-			             _("invalid boolean property “%s” (not yes or no)"),
-			             key);
-			break;
-		default:
-			g_set_error (info->error,
-			             NM_VPN_PLUGIN_ERROR,
-			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
-			             _("unhandled property “%s” type %s"),
-			             key, g_type_name (prop.type));
-			break;
-		}
-	}
+		g_set_error (info->error,
+		             NM_VPN_PLUGIN_ERROR,
+		             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
+		             _("invalid integer property “%s” or out of range [%d -> %d]"),
+		             key, prop->int_min, prop->int_max);
+		break;
+	case G_TYPE_BOOLEAN:
+		if (!strcmp (value, "yes") || !strcmp (value, "no"))
+			return; /* valid */
 
-	/* Did not find the property from valid_properties or the type did not match */
-	if (!info->table[i].name) {
 		g_set_error (info->error,
 		             NM_VPN_PLUGIN_ERROR,
 		             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
-		             _("property “%s” invalid or not supported"),
+		             /* Translators: keep "yes" and "no" untranslated! */
+		             _("invalid boolean property “%s” (not yes or no)"),
 		             key);
+		break;
+	default:
+		g_set_error (info->error,
+		             NM_VPN_PLUGIN_ERROR,
+		             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
+		             _("unhandled property “%s” type %s"),
+		             key, g_type_name (prop->type));
+		break;
 	}
 }
 
@@ -413,7 +546,7 @@ static gboolean
 nm_openvpn_properties_validate (NMSettingVpn *s_vpn, GError **error)
 {
 	GError *validate_error = NULL;
-	ValidateInfo info = { &valid_properties[0], &validate_error, FALSE };
+	ValidateInfo info = { NMV_PROPERTY_FLAG_DATA, &validate_error, FALSE };
 
 	nm_setting_vpn_foreach_data_item (s_vpn, validate_one_property, &info);
 	if (!info.have_items) {
@@ -435,7 +568,7 @@ static gboolean
 nm_openvpn_secrets_validate (NMSettingVpn *s_vpn, GError **error)
 {
 	GError *validate_error = NULL;
-	ValidateInfo info = { &valid_secrets[0], &validate_error, FALSE };
+	ValidateInfo info = { NMV_PROPERTY_FLAG_SECRET, &validate_error, FALSE };
 
 	nm_setting_vpn_foreach_secret (s_vpn, validate_one_property, &info);
 	if (validate_error) {
@@ -463,6 +596,9 @@ nm_openvpn_disconnect_management_socket (NMOpenvpnPlugin *plugin)
 		g_io_channel_unref (io_data->socket_channel);
 	}
 
+	if (io_data->read_buf)
+		g_string_free (io_data->read_buf, TRUE);
+
 	g_free (io_data->username);
 	g_free (io_data->proxy_username);
 	g_free (io_data->pending_auth);
@@ -481,6 +617,7 @@ nm_openvpn_disconnect_management_socket (NMOpenvpnPlugin *plugin)
 
 	g_free (priv->io_data);
 	priv->io_data = NULL;
+	gl.n_io_data--;
 }
 
 static char *
@@ -509,9 +646,7 @@ ovpn_quote_string (const char *unquoted)
 static char *
 get_detail (const char *input, const char *prefix)
 {
-	char *ret = NULL;
-	guint32 i = 0;
-	const char *p, *start;
+	const char *start, *end;
 
 	g_return_val_if_fail (prefix != NULL, NULL);
 
@@ -519,17 +654,9 @@ get_detail (const char *input, const char *prefix)
 		return NULL;
 
 	/* Grab characters until the next ' */
-	p = start = input + strlen (prefix);
-	while (*p) {
-		if (*p == '\'') {
-			ret = g_malloc0 (i + 1);
-			strncpy (ret, start, i);
-			break;
-		}
-		p++, i++;
-	}
-
-	return ret;
+	start = input + strlen (prefix);
+	end = strchr (start, '\'');
+	return end ? g_strndup (start, end - start) : NULL;
 }
 
 static void
@@ -645,40 +772,39 @@ handle_auth (NMOpenvpnPluginIOData *io_data,
 	return handled;
 }
 
+/*****************************************************************************/
+
+/* The management interface sends real-time messages of the form
+ * ">TYPE:data" and replies to our commands as "SUCCESS: ..." or
+ * "ERROR: ...". */
+
+typedef gboolean (*MgtMessageFunc) (NMOpenvpnPlugin *plugin,
+                                    const char *data,
+                                    NMVpnPluginFailure *out_failure);
+
 static gboolean
-handle_management_socket (NMOpenvpnPlugin *plugin,
-                          GIOChannel *source,
-                          GIOCondition condition,
-                          NMVpnPluginFailure *out_failure)
+mgt_message_password (NMOpenvpnPlugin *plugin,
+                      const char *data,
+                      NMVpnPluginFailure *out_failure)
 {
 	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
 	gboolean again = TRUE;
-	char *str = NULL, *auth = NULL;
+	char *auth;
 	const char *message = NULL;
 	char **hints = NULL;
 
-	g_assert (out_failure);
-
-	if (!(condition & G_IO_IN))
-		return TRUE;
-
-	if (g_io_channel_read_line (source, &str, NULL, NULL, NULL) != G_IO_STATUS_NORMAL)
-		return TRUE;
-
-	if (!str[0]) {
-		g_free (str);
-		return TRUE;
-	}
-
-	_LOGD ("VPN request '%s'", str);
-
-	auth = get_detail (str, ">PASSWORD:Need '");
+	auth = get_detail (data, "Need '");
 	if (auth) {
+		trace_event_once (plugin, "first-password-request");
+
 		if (priv->io_data->pending_auth)
 			g_free (priv->io_data->pending_auth);
 		priv->io_data->pending_auth = auth;
 
 		if (handle_auth (priv->io_data, auth, &message, &hints)) {
+			if (!message)
+				trace_event (plugin, "auth-reply");
+
 			/* Request new secrets if we need any */
 			if (message) {
 				if (priv->interactive) {
@@ -702,10 +828,10 @@ handle_management_socket (NMOpenvpnPlugin *plugin,
 			*out_failure = NM_VPN_PLUGIN_FAILURE_CONNECT_FAILED;
 			again = FALSE;
 		}
-		goto out;
+		return again;
 	}
 
-	auth = get_detail (str, ">PASSWORD:Verification Failed: '");
+	auth = get_detail (data, "Verification Failed: '");
 	if (auth) {
 		gboolean fail = TRUE;
 
@@ -733,8 +859,258 @@ handle_management_socket (NMOpenvpnPlugin *plugin,
 		g_free (auth);
 	}
 
-out:
-	g_free (str);
+	return again;
+}
+
+static gboolean
+mgt_message_ignore (NMOpenvpnPlugin *plugin,
+                    const char *data,
+                    NMVpnPluginFailure *out_failure)
+{
+	/* Nothing to do, the line was already logged. */
+	return TRUE;
+}
+
+/*****************************************************************************/
+
+static void
+bytecount_reset (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	priv->bytecount.bytes_in = 0;
+	priv->bytecount.bytes_out = 0;
+	priv->bytecount.len = 0;
+	priv->bytecount.head = 0;
+}
+
+static GVariant *
+bytecount_to_variant (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	GVariantBuilder builder;
+	guint64 rx_rate = 0, tx_rate = 0;
+	gint64 window = 0;
+
+	if (priv->bytecount.len >= 2) {
+		const BytecountSample *newest, *oldest;
+
+		newest = &priv->bytecount.samples[(priv->bytecount.head + priv->bytecount.n_samples - 1) % priv->bytecount.n_samples];
+		oldest = &priv->bytecount.samples[(priv->bytecount.head + priv->bytecount.n_samples - priv->bytecount.len) % priv->bytecount.n_samples];
+
+		window = newest->timestamp - oldest->timestamp;
+		if (window > 0) {
+			/* openvpn resets its counters on restart. */
+			if (newest->bytes_in >= oldest->bytes_in)
+				rx_rate = (newest->bytes_in - oldest->bytes_in) * G_USEC_PER_SEC / window;
+			if (newest->bytes_out >= oldest->bytes_out)
+				tx_rate = (newest->bytes_out - oldest->bytes_out) * G_USEC_PER_SEC / window;
+		}
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "bytes-in", g_variant_new_uint64 (priv->bytecount.bytes_in));
+	g_variant_builder_add (&builder, "{sv}", "bytes-out", g_variant_new_uint64 (priv->bytecount.bytes_out));
+	g_variant_builder_add (&builder, "{sv}", "rx-rate", g_variant_new_uint64 (rx_rate));
+	g_variant_builder_add (&builder, "{sv}", "tx-rate", g_variant_new_uint64 (tx_rate));
+	g_variant_builder_add (&builder, "{sv}", "window", g_variant_new_uint32 (window / G_USEC_PER_SEC));
+	return g_variant_builder_end (&builder);
+}
+
+/* >BYTECOUNT:{BYTES_IN},{BYTES_OUT} */
+static gboolean
+mgt_message_bytecount (NMOpenvpnPlugin *plugin,
+                       const char *data,
+                       NMVpnPluginFailure *out_failure)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	BytecountSample *sample;
+	guint64 bytes_in, bytes_out;
+	char *end;
+
+	bytes_in = g_ascii_strtoull (data, &end, 10);
+	if (end == data || *end != ',')
+		goto out_invalid;
+	data = &end[1];
+	bytes_out = g_ascii_strtoull (data, &end, 10);
+	if (end == data || *end)
+		goto out_invalid;
+
+	priv->bytecount.bytes_in = bytes_in;
+	priv->bytecount.bytes_out = bytes_out;
+
+	if (priv->bytecount.n_samples) {
+		sample = &priv->bytecount.samples[priv->bytecount.head];
+		sample->timestamp = g_get_monotonic_time ();
+		sample->bytes_in = bytes_in;
+		sample->bytes_out = bytes_out;
+		priv->bytecount.head = (priv->bytecount.head + 1) % priv->bytecount.n_samples;
+		if (priv->bytecount.len < priv->bytecount.n_samples)
+			priv->bytecount.len++;
+	}
+
+	if (priv->dbus_connection) {
+		g_dbus_connection_emit_signal (priv->dbus_connection,
+		                               NULL,
+		                               NM_VPN_DBUS_PLUGIN_PATH,
+		                               NM_DBUS_INTERFACE_OPENVPN,
+		                               "Statistics",
+		                               g_variant_new ("(@a{sv})", bytecount_to_variant (plugin)),
+		                               NULL);
+	}
+	return TRUE;
+
+out_invalid:
+	_LOGW ("Invalid byte count from openvpn");
+	return TRUE;
+}
+
+static void
+bytecount_start (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	NMOpenvpnPluginIOData *io_data = priv->io_data;
+	char buf[64];
+	guint n_samples;
+
+	bytecount_reset (plugin);
+
+	if (!priv->bytecount.interval)
+		return;
+
+	/* one more sample than intervals fit into the window */
+	n_samples = MAX (priv->bytecount.window / priv->bytecount.interval, 1) + 1;
+	if (n_samples != priv->bytecount.n_samples) {
+		g_free (priv->bytecount.samples);
+		priv->bytecount.n_samples = n_samples;
+		priv->bytecount.samples = g_new0 (BytecountSample, n_samples);
+	}
+
+	nm_sprintf_buf (buf, "bytecount %u\n", priv->bytecount.interval);
+	g_io_channel_write_chars (io_data->socket_channel, buf, strlen (buf), NULL, NULL);
+	g_io_channel_flush (io_data->socket_channel, NULL);
+}
+
+/*****************************************************************************/
+
+/* Sorted by name. */
+static const struct {
+	const char *name;
+	gsize name_len;
+	MgtMessageFunc func;
+} mgt_messages[] = {
+#define MGT_MESSAGE(name, func) { name, NM_STRLEN (name), func }
+	MGT_MESSAGE ("BYTECOUNT", mgt_message_bytecount),
+	MGT_MESSAGE ("HOLD",      mgt_message_ignore),
+	MGT_MESSAGE ("LOG",       mgt_message_ignore),
+	MGT_MESSAGE ("PASSWORD",  mgt_message_password),
+	MGT_MESSAGE ("STATE",     mgt_message_ignore),
+#undef MGT_MESSAGE
+};
+
+static gboolean
+mgt_dispatch_line (NMOpenvpnPlugin *plugin,
+                   const char *line,
+                   NMVpnPluginFailure *out_failure)
+{
+	const char *colon;
+	gsize name_len;
+	guint i;
+
+	_LOGD ("VPN request '%s'", line);
+
+	if (line[0] != '>') {
+		/* a reply to one of our commands */
+		return TRUE;
+	}
+
+	line++;
+	colon = strchr (line, ':');
+	if (!colon)
+		return TRUE;
+	name_len = colon - line;
+
+	for (i = 0; i < G_N_ELEMENTS (mgt_messages); i++) {
+		if (   mgt_messages[i].name_len == name_len
+		    && !memcmp (mgt_messages[i].name, line, name_len))
+			return mgt_messages[i].func (plugin, &colon[1], out_failure);
+	}
+	return TRUE;
+}
+
+#define MGT_READ_CHUNK 4096
+
+/* Append all data currently available on the management socket to
+ * the read buffer without blocking. */
+static void
+mgt_read_available (NMOpenvpnPluginIOData *io_data, gboolean *out_eof)
+{
+	GString *buf = io_data->read_buf;
+	int fd = g_io_channel_unix_get_fd (io_data->socket_channel);
+	gsize old_len;
+	gssize n;
+	int errsv;
+
+	*out_eof = FALSE;
+	for (;;) {
+		old_len = buf->len;
+		g_string_set_size (buf, old_len + MGT_READ_CHUNK);
+		n = recv (fd, &buf->str[old_len], MGT_READ_CHUNK, MSG_DONTWAIT);
+		errsv = errno;
+		g_string_set_size (buf, old_len + MAX (n, 0));
+
+		if (n > 0)
+			continue;
+		if (n < 0 && errsv == EINTR)
+			continue;
+		if (n == 0 || !NM_IN_SET (errsv, EAGAIN, EWOULDBLOCK))
+			*out_eof = TRUE;
+		return;
+	}
+}
+
+/* Reads everything available on the management socket and handles all
+ * complete lines. The lines are terminated in place in the read buffer
+ * and dispatched without copying them. Returns FALSE if the connection
+ * failed and sets @out_failure accordingly. */
+static gboolean
+handle_management_socket (NMOpenvpnPlugin *plugin,
+                          gboolean *out_eof,
+                          NMVpnPluginFailure *out_failure)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	GString *buf;
+	gboolean again = TRUE;
+	char *line, *eol;
+	gsize consumed = 0;
+
+	g_assert (out_failure);
+
+	if (!priv->io_data->read_buf)
+		priv->io_data->read_buf = g_string_sized_new (MGT_READ_CHUNK);
+	buf = priv->io_data->read_buf;
+
+	mgt_read_available (priv->io_data, out_eof);
+
+	while (   again
+	       && (eol = memchr (&buf->str[consumed], '\n', buf->len - consumed))) {
+		line = &buf->str[consumed];
+		consumed = (eol - buf->str) + 1;
+
+		*eol = '\0';
+		if (eol > line && eol[-1] == '\r')
+			eol[-1] = '\0';
+		if (!line[0])
+			continue;
+
+		again = mgt_dispatch_line (plugin, line, out_failure);
+
+		/* the handler might have dropped the io-data. */
+		if (!priv->io_data)
+			return again;
+	}
+
+	g_string_erase (buf, 0, consumed);
 	return again;
 }
 
@@ -742,67 +1118,183 @@ static gboolean
 nm_openvpn_socket_data_cb (GIOChannel *source, GIOCondition condition, gpointer user_data)
 {
 	NMOpenvpnPlugin *plugin = NM_OPENVPN_PLUGIN (user_data);
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
 	NMVpnPluginFailure failure = NM_VPN_PLUGIN_FAILURE_CONNECT_FAILED;
+	gboolean eof;
 
-	if (!handle_management_socket (plugin, source, condition, &failure)) {
+	if (!handle_management_socket (plugin, &eof, &failure)) {
+		if (priv->io_data)
+			priv->io_data->socket_channel_eventid = 0;
 		nm_vpn_service_plugin_failure ((NMVpnServicePlugin *) plugin, failure);
-		return FALSE;
+		return G_SOURCE_REMOVE;
 	}
 
-	return TRUE;
+	if (eof) {
+		/* openvpn is going away, we'll learn how from the child watch. */
+		priv->io_data->socket_channel_eventid = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+nm_openvpn_mgt_listen_clear (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	nm_clear_g_source (&priv->connect_timer);
+	nm_clear_g_source (&priv->mgt_listen_id);
+	if (priv->mgt_listen_channel) {
+		/* closes the listening socket */
+		g_io_channel_unref (priv->mgt_listen_channel);
+		priv->mgt_listen_channel = NULL;
+	}
+}
+
+static void
+mgt_attach_latency_record (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	gint64 latency_usec;
+	char buf[256];
+	char *b = buf;
+	gsize l = sizeof (buf);
+	guint i;
+
+	latency_usec = g_get_monotonic_time () - priv->mgt_attach_start;
+	for (i = 0; i < G_N_ELEMENTS (mgt_attach_hist_msec); i++) {
+		if (latency_usec < (gint64) mgt_attach_hist_msec[i] * 1000)
+			break;
+	}
+	gl.mgt_attach_hist[i]++;
+
+	if (!_LOGD_enabled ())
+		return;
+
+	buf[0] = '\0';
+	for (i = 0; i < G_N_ELEMENTS (mgt_attach_hist_msec); i++)
+		nm_utils_strbuf_append (&b, &l, " <%ums:%u", mgt_attach_hist_msec[i], gl.mgt_attach_hist[i]);
+	nm_utils_strbuf_append (&b, &l, " >=%ums:%u",
+	                        mgt_attach_hist_msec[G_N_ELEMENTS (mgt_attach_hist_msec) - 1],
+	                        gl.mgt_attach_hist[i]);
+
+	_LOGD ("openvpn attached to the management socket after %ld.%03ld ms (histogram:%s)",
+	       (long) (latency_usec / 1000), (long) (latency_usec % 1000), buf);
 }
 
 static gboolean
-nm_openvpn_connect_timer_cb (gpointer data)
+nm_openvpn_mgt_listen_cb (GIOChannel *source, GIOCondition condition, gpointer user_data)
 {
-	NMOpenvpnPlugin *plugin = NM_OPENVPN_PLUGIN (data);
+	NMOpenvpnPlugin *plugin = NM_OPENVPN_PLUGIN (user_data);
 	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
 	NMOpenvpnPluginIOData *io_data = priv->io_data;
-	struct sockaddr_un remote = { 0 };
-	int fd;
+	int fd, errsv;
+
+	fd = accept (g_io_channel_unix_get_fd (source), NULL, NULL);
+	if (fd < 0) {
+		errsv = errno;
+		if (NM_IN_SET (errsv, EAGAIN, EINTR))
+			return G_SOURCE_CONTINUE;
+
+		_LOGW ("Could not accept management connection: %s", g_strerror (errsv));
+		priv->mgt_listen_id = 0;
+		nm_openvpn_mgt_listen_clear (plugin);
+		nm_vpn_service_plugin_failure (NM_VPN_SERVICE_PLUGIN (plugin), NM_VPN_PLUGIN_FAILURE_CONNECT_FAILED);
+		return G_SOURCE_REMOVE;
+	}
+
+	/* openvpn connects only once, we don't need the listener anymore. */
+	priv->mgt_listen_id = 0;
+	nm_openvpn_mgt_listen_clear (plugin);
+
+	mgt_attach_latency_record (plugin);
+	trace_span_add (plugin, "mgt-attach", priv->mgt_attach_start);
+
+	io_data->socket_channel = g_io_channel_unix_new (fd);
+	g_io_channel_set_encoding (io_data->socket_channel, NULL, NULL);
+	io_data->socket_channel_eventid = g_io_add_watch (io_data->socket_channel,
+	                                                  G_IO_IN,
+	                                                  nm_openvpn_socket_data_cb,
+	                                                  plugin);
+
+	bytecount_start (plugin);
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+nm_openvpn_mgt_attach_timeout_cb (gpointer data)
+{
+	NMOpenvpnPlugin *plugin = NM_OPENVPN_PLUGIN (data);
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	priv->connect_timer = 0;
+	nm_openvpn_mgt_listen_clear (plugin);
+
+	_LOGW ("Could not open management socket");
+	nm_vpn_service_plugin_failure (NM_VPN_SERVICE_PLUGIN (plugin), NM_VPN_PLUGIN_FAILURE_CONNECT_FAILED);
+	return G_SOURCE_REMOVE;
+}
+
+/* Instead of polling until openvpn created its management socket, we
+ * listen on the socket ourselves and let openvpn connect to us
+ * (--management-client). That way we learn about openvpn being ready
+ * as soon as it is. */
+static gboolean
+nm_openvpn_mgt_listen (NMOpenvpnPlugin *plugin, GError **error)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	struct sockaddr_un local = { 0 };
+	int fd, errsv;
 
-	priv->connect_count++;
+	g_return_val_if_fail (priv->mgt_path, FALSE);
+	g_return_val_if_fail (!priv->mgt_listen_channel, FALSE);
+
+	/* a stale socket from a previous run would let bind() fail */
+	(void) unlink (priv->mgt_path);
 
-	/* open socket and start listener */
 	fd = socket (AF_UNIX, SOCK_STREAM, 0);
 	if (fd < 0) {
-		_LOGW ("Could not create management socket");
-		nm_vpn_service_plugin_failure (NM_VPN_SERVICE_PLUGIN (plugin), NM_VPN_PLUGIN_FAILURE_CONNECT_FAILED);
-		goto out;
+		errsv = errno;
+		g_set_error (error,
+		             NM_VPN_PLUGIN_ERROR,
+		             NM_VPN_PLUGIN_ERROR_LAUNCH_FAILED,
+		             "Could not create management socket (%s)",
+		             g_strerror (errsv));
+		return FALSE;
 	}
 
-	remote.sun_family = AF_UNIX;
-	g_strlcpy (remote.sun_path, priv->mgt_path, sizeof (remote.sun_path));
-	if (connect (fd, (struct sockaddr *) &remote, sizeof (remote)) != 0) {
+	local.sun_family = AF_UNIX;
+	g_strlcpy (local.sun_path, priv->mgt_path, sizeof (local.sun_path));
+	if (   bind (fd, (struct sockaddr *) &local, sizeof (local)) != 0
+	    || listen (fd, 1) != 0) {
+		errsv = errno;
 		close (fd);
-		if (priv->connect_count <= 30)
-			return G_SOURCE_CONTINUE;
-
-		priv->connect_timer = 0;
-
-		_LOGW ("Could not open management socket");
-		nm_vpn_service_plugin_failure (NM_VPN_SERVICE_PLUGIN (plugin), NM_VPN_PLUGIN_FAILURE_CONNECT_FAILED);
-	} else {
-		io_data->socket_channel = g_io_channel_unix_new (fd);
-		g_io_channel_set_encoding (io_data->socket_channel, NULL, NULL);
-		io_data->socket_channel_eventid = g_io_add_watch (io_data->socket_channel,
-		                                                  G_IO_IN,
-		                                                  nm_openvpn_socket_data_cb,
-		                                                  plugin);
+		g_set_error (error,
+		             NM_VPN_PLUGIN_ERROR,
+		             NM_VPN_PLUGIN_ERROR_LAUNCH_FAILED,
+		             "Could not listen on management socket %s (%s)",
+		             priv->mgt_path, g_strerror (errsv));
+		return FALSE;
 	}
 
-out:
-	priv->connect_timer = 0;
-	return G_SOURCE_REMOVE;
+	priv->mgt_listen_channel = g_io_channel_unix_new (fd);
+	g_io_channel_set_close_on_unref (priv->mgt_listen_channel, TRUE);
+	priv->mgt_listen_id = g_io_add_watch (priv->mgt_listen_channel,
+	                                      G_IO_IN,
+	                                      nm_openvpn_mgt_listen_cb,
+	                                      plugin);
+	return TRUE;
 }
 
 static void
-nm_openvpn_schedule_connect_timer (NMOpenvpnPlugin *plugin)
+nm_openvpn_mgt_attach_start (NMOpenvpnPlugin *plugin)
 {
 	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
 
+	priv->mgt_attach_start = g_get_monotonic_time ();
 	if (priv->connect_timer == 0)
-		priv->connect_timer = g_timeout_add (200, nm_openvpn_connect_timer_cb, plugin);
+		priv->connect_timer = g_timeout_add (MGT_ATTACH_TIMEOUT_MSEC, nm_openvpn_mgt_attach_timeout_cb, plugin);
 }
 
 static void
@@ -830,15 +1322,10 @@ openvpn_child_terminated (NMOpenvpnPlugin *plugin, GPid pid, gint status)
 
 	/* Try to get the last bits of data from openvpn */
 	if (priv->io_data && priv->io_data->socket_channel) {
-		GIOChannel *channel = priv->io_data->socket_channel;
-		GIOCondition condition;
+		gboolean eof;
 
-		while ((condition = g_io_channel_get_buffer_condition (channel)) & G_IO_IN) {
-			if (!handle_management_socket (plugin, channel, condition, &failure)) {
-				good_exit = FALSE;
-				break;
-			}
-		}
+		if (!handle_management_socket (plugin, &eof, &failure))
+			good_exit = FALSE;
 	}
 
 	if (good_exit)
@@ -886,26 +1373,6 @@ connection_type_is_tls_mode (const char *connection_type)
 	    || strcmp (connection_type, NM_OPENVPN_CONTYPE_PASSWORD_TLS) == 0;
 }
 
-static const char *
-nm_find_openvpn (void)
-{
-	static const char *openvpn_binary_paths[] = {
-		"/usr/sbin/openvpn",
-		"/sbin/openvpn",
-		"/usr/local/sbin/openvpn",
-		NULL
-	};
-	const char  **openvpn_binary = openvpn_binary_paths;
-
-	while (*openvpn_binary != NULL) {
-		if (g_file_test (*openvpn_binary, G_FILE_TEST_EXISTS))
-			break;
-		openvpn_binary++;
-	}
-
-	return *openvpn_binary;
-}
-
 static void
 add_openvpn_arg (GPtrArray *args, const char *arg)
 {
@@ -1034,20 +1501,21 @@ update_io_data_from_vpn_setting (NMOpenvpnPluginIOData *io_data,
 static char *
 mgt_path_create (NMConnection *connection, GError **error)
 {
+	const char *rundir = getenv_path ("NM_OPENVPN_RUNDIR", RUNDIR);
 	int errsv;
 
 	/* Setup runtime directory */
-	if (g_mkdir_with_parents (RUNDIR, 0755) != 0) {
+	if (g_mkdir_with_parents (rundir, 0755) != 0) {
 		errsv = errno;
 		g_set_error (error,
 		             NM_VPN_PLUGIN_ERROR,
 		             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 		             "Cannot create run-dir %s (%s)",
-		             RUNDIR, g_strerror (errsv));
+		             rundir, g_strerror (errsv));
 		return NULL;
 	}
 
-	return g_strdup_printf (RUNDIR"/nm-openvpn-%s",
+	return g_strdup_printf ("%s/nm-openvpn-%s", rundir,
 	                        nm_connection_get_uuid (connection));
 }
 
@@ -1108,33 +1576,120 @@ check_chroot_dir_usability (const char *chdir, const char *user)
 	return b1 && b2;
 }
 
+/* how long the result of run_as_check() stays valid. */
+#define RUN_AS_CHECK_MAX_AGE_SEC 60
+
+/* Look up the user and group to run openvpn as, and check whether the
+ * chroot directory is usable. With NSS backed by a directory service the
+ * lookups can be slow, so main() runs them once right after startup,
+ * while NetworkManager is still busy asking for secrets, and connect
+ * reuses the result. */
+static void
+run_as_check (void)
+{
+	gint64 now = g_get_monotonic_time ();
+
+	if (   gl.run_as.timestamp
+	    && now - gl.run_as.timestamp < RUN_AS_CHECK_MAX_AGE_SEC * G_USEC_PER_SEC)
+		return;
+
+	/* Allow openvpn to be run as a specified user:group.
+	 *
+	 * We do this by default. The only way to disable it is by setting
+	 * empty environment variables NM_OPENVPN_USER and NM_OPENVPN_GROUP. */
+	gl.run_as.user = getenv ("NM_OPENVPN_USER") ?: NM_OPENVPN_USER;
+	gl.run_as.group = getenv ("NM_OPENVPN_GROUP") ?: NM_OPENVPN_GROUP;
+	gl.run_as.user_found = *gl.run_as.user && getpwnam (gl.run_as.user);
+	gl.run_as.group_found = *gl.run_as.group && getgrnam (gl.run_as.group);
+
+	/* we try to chroot be default. The only way to disable that is by
+	 * setting the an empty environment variable NM_OPENVPN_CHROOT. */
+	gl.run_as.chroot = getenv ("NM_OPENVPN_CHROOT") ?: NM_OPENVPN_CHROOT;
+	gl.run_as.chroot_usable =    *gl.run_as.chroot
+	                          && check_chroot_dir_usability (gl.run_as.chroot, gl.run_as.user);
+
+	gl.run_as.timestamp = now;
+}
+
 static gboolean
-nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
-                                 NMConnection *connection,
-                                 GError **error)
+run_as_prewarm_cb (gpointer user_data)
 {
-	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
-	const char *openvpn_binary, *auth, *tmp, *tmp2, *tmp3, *tmp4;
+	run_as_check ();
+	return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+
+/* The argv of openvpn only depends on the data items of the VPN setting,
+ * the openvpn binary and on our own options, which don't change while we
+ * run. So we validate the setting and build the argv once per connection
+ * and reuse it as long as the fingerprint of the data items matches, for
+ * reconnects and restarts. Only the management socket path, and the user,
+ * group and chroot, which are checked periodically, are added on each
+ * connect. Secrets are not part of the argv and are validated each time. */
+
+static void
+argv_template_free (gpointer data)
+{
+	ArgvTemplate *tmpl = data;
+
+	g_free (tmpl->fingerprint);
+	g_strfreev (tmpl->argv);
+	g_free (tmpl);
+}
+
+static void
+fingerprint_add_key (const char *key, const char *value, gpointer user_data)
+{
+	g_ptr_array_add (user_data, g_strdup (key));
+}
+
+static char *
+argv_template_fingerprint (NMSettingVpn *s_vpn, const char *openvpn_binary)
+{
+	gs_unref_ptrarray GPtrArray *keys = NULL;
+	GChecksum *sum;
+	char *fingerprint;
+	guint i;
+
+	keys = g_ptr_array_new_with_free_func (g_free);
+	nm_setting_vpn_foreach_data_item (s_vpn, fingerprint_add_key, keys);
+	g_ptr_array_sort (keys, nm_strcmp_p);
+
+	sum = g_checksum_new (G_CHECKSUM_SHA256);
+	g_checksum_update (sum, (const guchar *) openvpn_binary, strlen (openvpn_binary) + 1);
+	for (i = 0; i < keys->len; i++) {
+		const char *key = keys->pdata[i];
+		const char *value = nm_setting_vpn_get_data_item (s_vpn, key) ?: "";
+
+		/* include the terminating NUL, so that "ab" "c" and "a" "bc" differ. */
+		g_checksum_update (sum, (const guchar *) key, strlen (key) + 1);
+		g_checksum_update (sum, (const guchar *) value, strlen (value) + 1);
+	}
+	fingerprint = g_strdup (g_checksum_get_string (sum));
+	g_checksum_free (sum);
+	return fingerprint;
+}
+
+static ArgvTemplate *
+argv_template_compile (NMOpenvpnPlugin *plugin,
+                       NMSettingVpn *s_vpn,
+                       const char *openvpn_binary,
+                       GError **error)
+{
+	const char *auth, *tmp, *tmp2, *tmp3, *tmp4;
 	gs_unref_ptrarray GPtrArray *args = NULL;
-	GPid pid;
 	gboolean dev_type_is_tap;
 	char *stmp;
 	const char *defport, *proto_tcp;
-	const char *nm_openvpn_user, *nm_openvpn_group, *nm_openvpn_chroot;
 	gs_free char *bus_name = NULL;
-	NMSettingVpn *s_vpn;
 	const char *connection_type;
+	gboolean use_mgt_socket;
+	guint mgt_path_idx;
+	guint trace_span;
 	gint64 v_int64;
 	char sbuf_64[65];
-
-	s_vpn = nm_connection_get_setting_vpn (connection);
-	if (!s_vpn) {
-		g_set_error_literal (error,
-		                     NM_VPN_PLUGIN_ERROR,
-		                     NM_VPN_PLUGIN_ERROR_INVALID_CONNECTION,
-		                     _("Could not process the request because the VPN connection settings were invalid."));
-		return FALSE;
-	}
+	ArgvTemplate *tmpl;
 
 	connection_type = nm_setting_vpn_get_data_item (s_vpn, NM_OPENVPN_KEY_CONNECTION_TYPE);
 	if (!validate_connection_type (connection_type)) {
@@ -1142,26 +1697,24 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 		                     NM_VPN_PLUGIN_ERROR,
 		                     NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 		                     _("Invalid connection type."));
-		return FALSE;
+		return NULL;
 	}
 
-	/* Validate the properties */
-	if (!nm_openvpn_properties_validate (s_vpn, error))
-		return FALSE;
+	/* We talk to openvpn via the management socket for a few connection types:
+	   PASSWORD: Will require username and password
+	   X509USERPASS: Will require username and password and maybe certificate password
+	   X509: May require certificate password
+	*/
+	use_mgt_socket =    !strcmp (connection_type, NM_OPENVPN_CONTYPE_TLS)
+	                 || !strcmp (connection_type, NM_OPENVPN_CONTYPE_PASSWORD)
+	                 || !strcmp (connection_type, NM_OPENVPN_CONTYPE_PASSWORD_TLS)
+	                 || nm_setting_vpn_get_data_item (s_vpn, NM_OPENVPN_KEY_HTTP_PROXY_USERNAME);
 
-	/* Validate secrets */
-	if (!nm_openvpn_secrets_validate (s_vpn, error))
-		return FALSE;
+	trace_span = trace_span_begin (plugin, "validate");
 
-	/* Find openvpn */
-	openvpn_binary = nm_find_openvpn ();
-	if (!openvpn_binary) {
-		g_set_error_literal (error,
-		                     NM_VPN_PLUGIN_ERROR,
-		                     NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
-		                     _("Could not find the openvpn binary."));
-		return FALSE;
-	}
+	/* Validate the properties */
+	if (!nm_openvpn_properties_validate (s_vpn, error))
+		return NULL;
 
 	auth = nm_setting_vpn_get_data_item (s_vpn, NM_OPENVPN_KEY_AUTH);
 	if (auth) {
@@ -1170,10 +1723,13 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			                     NM_VPN_PLUGIN_ERROR,
 			                     NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			                     _("Invalid HMAC auth."));
-			return FALSE;
+			return NULL;
 		}
 	}
 
+	trace_span_end (plugin, trace_span);
+	trace_span = trace_span_begin (plugin, "build-args");
+
 	args = g_ptr_array_new_with_free_func (g_free);
 
 	add_openvpn_arg (args, openvpn_binary);
@@ -1212,7 +1768,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 					             NM_VPN_PLUGIN_ERROR,
 					             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 					             _("Invalid port number “%s”."), port);
-					return FALSE;
+					return NULL;
 				}
 			} else if (defport) {
 				if (!add_openvpn_arg_int (args, defport)) {
@@ -1221,7 +1777,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 					             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 					             _("Invalid port number “%s”."),
 					             defport);
-					return FALSE;
+					return NULL;
 				}
 			} else
 				add_openvpn_arg (args, "1194"); /* default IANA port */
@@ -1236,7 +1792,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 					             NM_VPN_PLUGIN_ERROR,
 					             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 					             _("Invalid proto “%s”."), proto);
-					return FALSE;
+					return NULL;
 				}
 			} else if (proto_tcp && !strcmp (proto_tcp, "yes"))
 				add_openvpn_arg (args, "tcp-client");
@@ -1279,7 +1835,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 				         NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 				         _("Invalid proxy type “%s”."),
 				         tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1327,7 +1883,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid ping duration “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1340,7 +1896,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid ping-exit duration “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1353,7 +1909,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid ping-restart duration “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1372,7 +1928,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid max-routes argument “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1427,7 +1983,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid keysize “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1473,7 +2029,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			g_set_error (error, NM_VPN_PLUGIN_ERROR,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid verify-x509-name."));
-			return FALSE;
+			return NULL;
 		}
 
 		add_openvpn_arg (args, "--verify-x509-name");
@@ -1508,7 +2064,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid reneg seconds “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	} else {
 		/* Either the server and client must agree on the renegotiation
@@ -1540,7 +2096,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid TUN MTU size “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1554,7 +2110,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Invalid fragment size “%s”."),
 			             tmp);
-			return FALSE;
+			return NULL;
 		}
 	}
 
@@ -1577,13 +2133,15 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 	add_openvpn_arg (args, "2");
 
 	/* Up script, called when connection has been established or has been restarted */
+	tmp = nm_setting_vpn_get_data_item (s_vpn, NM_OPENVPN_KEY_AGGREGATE_ROUTES);
 	add_openvpn_arg (args, "--up");
 	g_object_get (plugin, NM_VPN_SERVICE_PLUGIN_DBUS_SERVICE_NAME, &bus_name, NULL);
-	stmp = g_strdup_printf ("%s --debug %d %ld --bus-name %s %s --",
-	                        NM_OPENVPN_HELPER_PATH,
+	stmp = g_strdup_printf ("%s --debug %d %ld --bus-name %s %s%s --",
+	                        getenv_path ("NM_OPENVPN_HELPER", NM_OPENVPN_HELPER_PATH),
 	                        gl.log_level, (long) getpid(),
 	                        bus_name,
-	                        dev_type_is_tap ? "--tap" : "--tun");
+	                        dev_type_is_tap ? "--tap" : "--tun",
+	                        nm_streq0 (tmp, "yes") ? " --aggregate-routes" : "");
 	add_openvpn_arg (args, stmp);
 	g_free (stmp);
 	add_openvpn_arg (args, "--up-restart");
@@ -1593,13 +2151,12 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 	add_openvpn_arg (args, "--persist-tun");
 
 	/* Management socket for localhost access to supply username and password */
-	g_clear_pointer (&priv->mgt_path, g_free);
-	priv->mgt_path = mgt_path_create (connection, error);
-	if (!priv->mgt_path)
-		return FALSE;
 	add_openvpn_arg (args, "--management");
-	add_openvpn_arg (args, priv->mgt_path);
+	mgt_path_idx = args->len;
+	add_openvpn_arg (args, "");
 	add_openvpn_arg (args, "unix");
+	if (use_mgt_socket)
+		add_openvpn_arg (args, "--management-client");
 	add_openvpn_arg (args, "--management-client-user");
 	add_openvpn_arg (args, "root");
 	add_openvpn_arg (args, "--management-client-group");
@@ -1638,7 +2195,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			                     NM_VPN_PLUGIN_ERROR,
 			                     NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			                     _("Missing required local IP address for static key mode."));
-			return FALSE;
+			return NULL;
 		}
 		add_openvpn_arg (args, tmp);
 
@@ -1649,7 +2206,7 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 			                     NM_VPN_PLUGIN_ERROR,
 			                     NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			                     _("Missing required remote IP address for static key mode."));
-			return FALSE;
+			return NULL;
 		}
 		add_openvpn_arg (args, tmp);
 	} else if (!strcmp (connection_type, NM_OPENVPN_CONTYPE_PASSWORD)) {
@@ -1674,52 +2231,130 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 		             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 		             _("Unknown connection type “%s”."),
 		             connection_type);
+		return NULL;
+	}
+
+	g_ptr_array_add (args, NULL);
+
+	trace_span_end (plugin, trace_span);
+
+	tmpl = g_new0 (ArgvTemplate, 1);
+	tmpl->argv = (char **) g_ptr_array_free (g_steal_pointer (&args), FALSE);
+	tmpl->mgt_path_idx = mgt_path_idx;
+	tmpl->use_mgt_socket = use_mgt_socket;
+	return tmpl;
+}
+
+static gboolean
+nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
+                                 NMConnection *connection,
+                                 GError **error)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	const char *openvpn_binary;
+	gs_unref_ptrarray GPtrArray *args = NULL;
+	gs_free char *fingerprint = NULL;
+	ArgvTemplate *tmpl;
+	NMSettingVpn *s_vpn;
+	const char *uuid;
+	GPid pid;
+	guint trace_span;
+	guint i;
+
+	s_vpn = nm_connection_get_setting_vpn (connection);
+	if (!s_vpn) {
+		g_set_error_literal (error,
+		                     NM_VPN_PLUGIN_ERROR,
+		                     NM_VPN_PLUGIN_ERROR_INVALID_CONNECTION,
+		                     _("Could not process the request because the VPN connection settings were invalid."));
 		return FALSE;
 	}
 
-	/* Allow openvpn to be run as a specified user:group.
-	 *
-	 * We do this by default. The only way to disable it is by setting
-	 * empty environment variables NM_OPENVPN_USER and NM_OPENVPN_GROUP. */
-	nm_openvpn_user = getenv ("NM_OPENVPN_USER") ?: NM_OPENVPN_USER;
-	nm_openvpn_group = getenv ("NM_OPENVPN_GROUP") ?: NM_OPENVPN_GROUP;
-	if (*nm_openvpn_user) {
-		if (getpwnam (nm_openvpn_user)) {
-			add_openvpn_arg (args, "--user");
-			add_openvpn_arg (args, nm_openvpn_user);
+	/* Validate secrets */
+	if (!nm_openvpn_secrets_validate (s_vpn, error))
+		return FALSE;
+
+	/* Find openvpn */
+	openvpn_binary = getenv_path ("NM_OPENVPN_BINARY", nmovpn_binary_find ());
+	if (!openvpn_binary) {
+		g_set_error_literal (error,
+		                     NM_VPN_PLUGIN_ERROR,
+		                     NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
+		                     _("Could not find the openvpn binary."));
+		return FALSE;
+	}
+
+	uuid = nm_connection_get_uuid (connection) ?: "";
+	fingerprint = argv_template_fingerprint (s_vpn, openvpn_binary);
+
+	if (!priv->argv_templates)
+		priv->argv_templates = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, argv_template_free);
+
+	tmpl = g_hash_table_lookup (priv->argv_templates, uuid);
+	if (tmpl && nm_streq (tmpl->fingerprint, fingerprint))
+		trace_event (plugin, "args-cached");
+	else {
+		g_hash_table_remove (priv->argv_templates, uuid);
+		tmpl = argv_template_compile (plugin, s_vpn, openvpn_binary, error);
+		if (!tmpl)
+			return FALSE;
+		tmpl->fingerprint = g_steal_pointer (&fingerprint);
+		g_hash_table_insert (priv->argv_templates, g_strdup (uuid), tmpl);
+	}
+
+	/* the statistics are not part of the openvpn arguments. */
+	priv->bytecount.interval = _nm_utils_ascii_str_to_int64 (nm_setting_vpn_get_data_item (s_vpn, NM_OPENVPN_KEY_BYTECOUNT_INTERVAL),
+	                                                         10, 0, 86400, 0);
+	priv->bytecount.window = _nm_utils_ascii_str_to_int64 (nm_setting_vpn_get_data_item (s_vpn, NM_OPENVPN_KEY_BYTECOUNT_WINDOW),
+	                                                       10, 1, 86400, 60);
+	priv->bytecount.window = MAX (priv->bytecount.window, priv->bytecount.interval);
+
+	g_clear_pointer (&priv->mgt_path, g_free);
+	priv->mgt_path = mgt_path_create (connection, error);
+	if (!priv->mgt_path)
+		return FALSE;
+
+	/* the strings belong to the template. Leave room for user, group,
+	 * chroot and the terminating NULL. */
+	args = g_ptr_array_sized_new (g_strv_length (tmpl->argv) + 7);
+	for (i = 0; tmpl->argv[i]; i++)
+		g_ptr_array_add (args, i == tmpl->mgt_path_idx ? priv->mgt_path : tmpl->argv[i]);
+
+	run_as_check ();
+	if (*gl.run_as.user) {
+		if (gl.run_as.user_found) {
+			g_ptr_array_add (args, "--user");
+			g_ptr_array_add (args, (char *) gl.run_as.user);
 		} else {
 			g_set_error (error,
 			             NM_VPN_PLUGIN_ERROR,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("User “%s” not found, check NM_OPENVPN_USER."),
-			             nm_openvpn_user);
+			             gl.run_as.user);
 			return FALSE;
 		}
 	}
-	if (*nm_openvpn_group) {
-		if (getgrnam (nm_openvpn_group)) {
-			add_openvpn_arg (args, "--group");
-			add_openvpn_arg (args, nm_openvpn_group);
+	if (*gl.run_as.group) {
+		if (gl.run_as.group_found) {
+			g_ptr_array_add (args, "--group");
+			g_ptr_array_add (args, (char *) gl.run_as.group);
 		} else {
 			g_set_error (error,
 			             NM_VPN_PLUGIN_ERROR,
 			             NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS,
 			             _("Group “%s” not found, check NM_OPENVPN_GROUP."),
-			             nm_openvpn_group);
+			             gl.run_as.group);
 			return FALSE;
 		}
 	}
 
-	/* we try to chroot be default. The only way to disable that is by
-	 * setting the an empty environment variable NM_OPENVPN_CHROOT. */
-	nm_openvpn_chroot = getenv ("NM_OPENVPN_CHROOT") ?: NM_OPENVPN_CHROOT;
-	if (*nm_openvpn_chroot) {
-		if (check_chroot_dir_usability (nm_openvpn_chroot, nm_openvpn_user)) {
-			add_openvpn_arg (args, "--chroot");
-			add_openvpn_arg (args, nm_openvpn_chroot);
+	if (*gl.run_as.chroot) {
+		if (gl.run_as.chroot_usable) {
+			g_ptr_array_add (args, "--chroot");
+			g_ptr_array_add (args, (char *) gl.run_as.chroot);
 		} else
 			_LOGW ("Directory '%s' not usable for chroot by '%s', openvpn will not be chrooted.",
-			        nm_openvpn_chroot, nm_openvpn_user);
+			        gl.run_as.chroot, gl.run_as.user);
 	}
 
 	g_ptr_array_add (args, NULL);
@@ -1730,29 +2365,30 @@ nm_openvpn_start_openvpn_binary (NMOpenvpnPlugin *plugin,
 		_LOGD ("EXEC: '%s'", (cmd = g_strjoinv (" ", (char **) args->pdata)));
 	}
 
+	/* openvpn connects to the management socket right after start, so
+	 * we must be listening before spawning it. */
+	if (tmpl->use_mgt_socket && !nm_openvpn_mgt_listen (plugin, error))
+		return FALSE;
+
+	trace_span = trace_span_begin (plugin, "spawn");
 	if (!g_spawn_async (NULL, (char **) args->pdata, NULL,
-	                    G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, error))
+	                    G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, error)) {
+		nm_openvpn_mgt_listen_clear (plugin);
 		return FALSE;
+	}
+	trace_span_end (plugin, trace_span);
 
 	pids_pending_add (pid, plugin);
 
 	g_warn_if_fail (!priv->pid);
 	priv->pid = pid;
 
-	/* Listen to the management socket for a few connection types:
-	   PASSWORD: Will require username and password
-	   X509USERPASS: Will require username and password and maybe certificate password
-	   X509: May require certificate password
-	*/
-	if (   !strcmp (connection_type, NM_OPENVPN_CONTYPE_TLS)
-	    || !strcmp (connection_type, NM_OPENVPN_CONTYPE_PASSWORD)
-	    || !strcmp (connection_type, NM_OPENVPN_CONTYPE_PASSWORD_TLS)
-	    || nm_setting_vpn_get_data_item (s_vpn, NM_OPENVPN_KEY_HTTP_PROXY_USERNAME)) {
-
+	if (tmpl->use_mgt_socket) {
 		priv->io_data = g_malloc0 (sizeof (NMOpenvpnPluginIOData));
+		gl.n_io_data++;
 		update_io_data_from_vpn_setting (priv->io_data, s_vpn,
 		                                 nm_setting_vpn_get_user_name (s_vpn));
-		nm_openvpn_schedule_connect_timer (plugin);
+		nm_openvpn_mgt_attach_start (plugin);
 	}
 
 	return TRUE;
@@ -1822,6 +2458,9 @@ real_disconnect (NMVpnServicePlugin *plugin,
 {
 	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
 
+	nm_openvpn_mgt_listen_clear (NM_OPENVPN_PLUGIN (plugin));
+	nm_openvpn_disconnect_management_socket (NM_OPENVPN_PLUGIN (plugin));
+
 	if (priv->mgt_path) {
 		/* openvpn does not cleanup the management socket upon exit,
 		 * possibly it could not even because it changed user */
@@ -1844,15 +2483,21 @@ _connect_common (NMVpnServicePlugin   *plugin,
                  GError       **error)
 {
 	GError *local = NULL;
+	gboolean success;
+	guint trace_span;
 
 	if (!real_disconnect (plugin, &local)) {
 		_LOGW ("Could not clean up previous daemon run: %s", local->message);
 		g_error_free (local);
 	}
 
-	return nm_openvpn_start_openvpn_binary (NM_OPENVPN_PLUGIN (plugin),
-	                                        connection,
-	                                        error);
+	trace_begin (NM_OPENVPN_PLUGIN (plugin), connection);
+	trace_span = trace_span_begin (NM_OPENVPN_PLUGIN (plugin), "start-binary");
+	success = nm_openvpn_start_openvpn_binary (NM_OPENVPN_PLUGIN (plugin),
+	                                           connection,
+	                                           error);
+	trace_span_end (NM_OPENVPN_PLUGIN (plugin), trace_span);
+	return success;
 }
 
 static gboolean
@@ -1885,10 +2530,14 @@ real_need_secrets (NMVpnServicePlugin *plugin,
 	NMSettingVpn *s_vpn;
 	const char *connection_type;
 	gboolean need_secrets = FALSE;
+	guint trace_span;
 
 	g_return_val_if_fail (NM_IS_VPN_SERVICE_PLUGIN (plugin), FALSE);
 	g_return_val_if_fail (NM_IS_CONNECTION (connection), FALSE);
 
+	trace_begin (NM_OPENVPN_PLUGIN (plugin), connection);
+	trace_span = trace_span_begin (NM_OPENVPN_PLUGIN (plugin), "need-secrets");
+
 	if (_LOGD_enabled ()) {
 		_LOGD ("connection -------------------------------------");
 		nm_connection_dump (connection);
@@ -1904,6 +2553,7 @@ real_need_secrets (NMVpnServicePlugin *plugin,
 	}
 
 	connection_type = check_need_secrets (s_vpn, &need_secrets);
+	trace_span_end (NM_OPENVPN_PLUGIN (plugin), trace_span);
 	if (!connection_type) {
 		g_set_error_literal (error,
 		                     NM_VPN_PLUGIN_ERROR,
@@ -1950,6 +2600,9 @@ real_new_secrets (NMVpnServicePlugin *plugin,
 		return FALSE;
 	}
 
+	if (!message)
+		trace_event (NM_OPENVPN_PLUGIN (plugin), "auth-reply");
+
 	/* Request new secrets if we need any */
 	if (message) {
 		_LOGD ("Requesting new secrets: '%s'", message);
@@ -1970,7 +2623,9 @@ dispose (GObject *object)
 {
 	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (object);
 
-	nm_clear_g_source (&priv->connect_timer);
+	nm_openvpn_mgt_listen_clear (NM_OPENVPN_PLUGIN (object));
+	nm_openvpn_disconnect_management_socket (NM_OPENVPN_PLUGIN (object));
+	nm_openvpn_plugin_unexport (NM_OPENVPN_PLUGIN (object));
 
 	if (priv->pid) {
 		pids_pending_send_sigterm (priv->pid);
@@ -1980,6 +2635,23 @@ dispose (GObject *object)
 	G_OBJECT_CLASS (nm_openvpn_plugin_parent_class)->dispose (object);
 }
 
+static void
+finalize (GObject *object)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (object);
+
+	g_free (priv->bytecount.samples);
+	g_free (priv->trace.uuid);
+	if (priv->trace.spans)
+		g_array_unref (priv->trace.spans);
+	g_free (priv->ip4_routes_digest);
+	g_free (priv->ip6_routes_digest);
+	if (priv->argv_templates)
+		g_hash_table_unref (priv->argv_templates);
+
+	G_OBJECT_CLASS (nm_openvpn_plugin_parent_class)->finalize (object);
+}
+
 static void
 nm_openvpn_plugin_class_init (NMOpenvpnPluginClass *plugin_class)
 {
@@ -1989,6 +2661,7 @@ nm_openvpn_plugin_class_init (NMOpenvpnPluginClass *plugin_class)
 	g_type_class_add_private (object_class, sizeof (NMOpenvpnPluginPrivate));
 
 	object_class->dispose = dispose;
+	object_class->finalize = finalize;
 
 	/* virtual methods */
 	parent_class->connect      = real_connect;
@@ -1998,6 +2671,113 @@ nm_openvpn_plugin_class_init (NMOpenvpnPluginClass *plugin_class)
 	parent_class->new_secrets  = real_new_secrets;
 }
 
+/*****************************************************************************/
+
+static const char openvpn_introspection_xml[] =
+	"<node>"
+	"  <interface name='" NM_DBUS_INTERFACE_OPENVPN "'>"
+	"    <method name='GetStatistics'>"
+	"      <arg name='statistics' type='a{sv}' direction='out'/>"
+	"    </method>"
+	"    <signal name='Statistics'>"
+	"      <arg name='statistics' type='a{sv}'/>"
+	"    </signal>"
+	"    <method name='GetRouteDigests'>"
+	"      <arg name='ip4' type='s' direction='out'/>"
+	"      <arg name='ip6' type='s' direction='out'/>"
+	"    </method>"
+	"  </interface>"
+	"</node>";
+
+static void
+openvpn_method_call (GDBusConnection *connection,
+                     const char *sender,
+                     const char *object_path,
+                     const char *interface_name,
+                     const char *method_name,
+                     GVariant *parameters,
+                     GDBusMethodInvocation *invocation,
+                     gpointer user_data)
+{
+	NMOpenvpnPlugin *plugin = NM_OPENVPN_PLUGIN (user_data);
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	if (nm_streq (method_name, "GetStatistics")) {
+		g_dbus_method_invocation_return_value (invocation,
+		                                       g_variant_new ("(@a{sv})", bytecount_to_variant (plugin)));
+		return;
+	}
+
+	if (nm_streq (method_name, "GetRouteDigests")) {
+		g_dbus_method_invocation_return_value (invocation,
+		                                       g_variant_new ("(ss)",
+		                                                      priv->ip4_routes_digest ?: "",
+		                                                      priv->ip6_routes_digest ?: ""));
+		return;
+	}
+
+	g_dbus_method_invocation_return_error (invocation,
+	                                       G_DBUS_ERROR,
+	                                       G_DBUS_ERROR_UNKNOWN_METHOD,
+	                                       "Unknown method %s",
+	                                       method_name);
+}
+
+static const GDBusInterfaceVTable openvpn_interface_vtable = {
+	openvpn_method_call,
+	NULL,
+	NULL,
+};
+
+/* Besides the generic VPN plugin interface, export our own interface
+ * on the same object for clients interested in openvpn specifics. */
+static void
+nm_openvpn_plugin_export (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+	static GDBusNodeInfo *node_info = NULL;
+	GError *error = NULL;
+
+	if (!node_info)
+		node_info = g_dbus_node_info_new_for_xml (openvpn_introspection_xml, NULL);
+
+	/* this is the connection the VPN plugin interface is exported on. */
+	priv->dbus_connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (!priv->dbus_connection)
+		goto out_error;
+
+	priv->dbus_registration_id = g_dbus_connection_register_object (priv->dbus_connection,
+	                                                                NM_VPN_DBUS_PLUGIN_PATH,
+	                                                                node_info->interfaces[0],
+	                                                                &openvpn_interface_vtable,
+	                                                                plugin,
+	                                                                NULL,
+	                                                                &error);
+	if (!priv->dbus_registration_id) {
+		g_clear_object (&priv->dbus_connection);
+		goto out_error;
+	}
+	return;
+
+out_error:
+	_LOGW ("Failed to export the " NM_DBUS_INTERFACE_OPENVPN " interface: %s", error->message);
+	g_error_free (error);
+}
+
+static void
+nm_openvpn_plugin_unexport (NMOpenvpnPlugin *plugin)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	if (priv->dbus_registration_id) {
+		g_dbus_connection_unregister_object (priv->dbus_connection, priv->dbus_registration_id);
+		priv->dbus_registration_id = 0;
+	}
+	g_clear_object (&priv->dbus_connection);
+}
+
+/*****************************************************************************/
+
 static void
 plugin_state_changed (NMOpenvpnPlugin *plugin,
                       NMVpnServiceState state,
@@ -2012,14 +2792,85 @@ plugin_state_changed (NMOpenvpnPlugin *plugin,
 	case NM_VPN_SERVICE_STATE_STOPPING:
 	case NM_VPN_SERVICE_STATE_STOPPED:
 		/* Cleanup on failure */
-		nm_clear_g_source (&priv->connect_timer);
+		nm_openvpn_mgt_listen_clear (plugin);
 		nm_openvpn_disconnect_management_socket (plugin);
+		trace_dump (plugin);
+		nm_clear_g_free (&priv->ip4_routes_digest);
+		nm_clear_g_free (&priv->ip6_routes_digest);
 		break;
 	default:
 		break;
 	}
 }
 
+static void
+plugin_config_received (NMOpenvpnPlugin *plugin,
+                        GVariant *config,
+                        gpointer user_data)
+{
+	/* the helper script handed over its configuration. */
+	trace_event (plugin, user_data);
+}
+
+/* Remember the routes of the last IP config, so that the helper script
+ * can tell on a restart whether they changed. */
+static void
+routes_digest_update (char **digest,
+                      GVariant *config,
+                      const char *routes_key,
+                      const GVariantType *routes_type,
+                      const char *preserve_key)
+{
+	gs_unref_variant GVariant *routes = NULL;
+	gboolean preserve = FALSE;
+
+	routes = g_variant_lookup_value (config, routes_key, routes_type);
+	if (routes) {
+		g_free (*digest);
+		*digest = nmv_utils_routes_digest (routes);
+		return;
+	}
+
+	/* without routes and without preserving the previous ones NetworkManager
+	 * clears them. */
+	if (   !g_variant_lookup (config, preserve_key, "b", &preserve)
+	    || !preserve)
+		nm_clear_g_free (digest);
+}
+
+static void
+plugin_ip4_config_received (NMOpenvpnPlugin *plugin,
+                            GVariant *config,
+                            gpointer user_data)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	trace_event (plugin, "set-ip4-config");
+	routes_digest_update (&priv->ip4_routes_digest, config,
+	                      NM_VPN_PLUGIN_IP4_CONFIG_ROUTES,
+	                      G_VARIANT_TYPE ("aau"),
+	                      NM_VPN_PLUGIN_IP4_CONFIG_PRESERVE_ROUTES);
+}
+
+static void
+plugin_ip6_config_received (NMOpenvpnPlugin *plugin,
+                            GVariant *config,
+                            gpointer user_data)
+{
+	NMOpenvpnPluginPrivate *priv = NM_OPENVPN_PLUGIN_GET_PRIVATE (plugin);
+
+	trace_event (plugin, "set-ip6-config");
+	routes_digest_update (&priv->ip6_routes_digest, config,
+	                      NM_VPN_PLUGIN_IP6_CONFIG_ROUTES,
+	                      G_VARIANT_TYPE ("a(ayuayu)"),
+	                      NM_VPN_PLUGIN_IP6_CONFIG_PRESERVE_ROUTES);
+}
+
+/* There is one plugin instance per process. NMVpnServicePlugin always
+ * exports its interface at NM_VPN_DBUS_PLUGIN_PATH on the shared system
+ * bus connection, so a second instance in the same process could not
+ * register itself. NetworkManager also addresses each connection by the
+ * bus name of its own service process. */
 NMOpenvpnPlugin *
 nm_openvpn_plugin_new (const char *bus_name)
 {
@@ -2033,6 +2884,10 @@ nm_openvpn_plugin_new (const char *bus_name)
 
 	if (plugin) {
 		g_signal_connect (G_OBJECT (plugin), "state-changed", G_CALLBACK (plugin_state_changed), NULL);
+		g_signal_connect (G_OBJECT (plugin), "config", G_CALLBACK (plugin_config_received), "set-config");
+		g_signal_connect (G_OBJECT (plugin), "ip4-config", G_CALLBACK (plugin_ip4_config_received), NULL);
+		g_signal_connect (G_OBJECT (plugin), "ip6-config", G_CALLBACK (plugin_ip6_config_received), NULL);
+		nm_openvpn_plugin_export (plugin);
 	} else {
 		_LOGW ("Failed to initialize a plugin instance: %s", error->message);
 		g_error_free (error);
@@ -2141,6 +2996,8 @@ main (int argc, char *argv[])
 
 	loop = g_main_loop_new (NULL, FALSE);
 
+	g_idle_add (run_as_prewarm_cb, NULL);
+
 	if (!persist)
 		g_signal_connect (plugin, "quit", G_CALLBACK (quit_mainloop), loop);
 
@@ -2155,5 +3012,12 @@ main (int argc, char *argv[])
 
 	g_main_loop_unref (loop);
 
+	/* only the tests treat a leak at shutdown as failure. */
+	if (gl.n_io_data) {
+		_LOGW ("%u management socket states were leaked", gl.n_io_data);
+		if (getenv ("NM_OPENVPN_CHECK_LEAKS"))
+			exit (EXIT_FAILURE);
+	}
+
 	exit (EXIT_SUCCESS);
 }
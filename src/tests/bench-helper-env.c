@@ -0,0 +1,145 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Times nmovpn_helper_env_parse() on environments like the ones openvpn
+ * passes to the helper, with N IPv4 routes, N IPv6 routes and N foreign
+ * options each. openvpn waits for the helper before it continues to
+ * connect.
+ *
+ * Usage: bench-helper-env [N...]
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+
+#include "nm-openvpn-helper-env.h"
+
+#include "bench-utils.h"
+
+#define N_ITERATIONS 20
+
+/*****************************************************************************/
+
+static char **
+_generate_env (guint n)
+{
+	GPtrArray *env;
+	guint i;
+
+	env = g_ptr_array_new ();
+
+	g_ptr_array_add (env, g_strdup ("PATH=/usr/local/bin:/usr/bin:/bin"));
+	g_ptr_array_add (env, g_strdup ("script_type=up"));
+	g_ptr_array_add (env, g_strdup ("trusted_ip=192.0.2.1"));
+	g_ptr_array_add (env, g_strdup ("trusted_port=1194"));
+	g_ptr_array_add (env, g_strdup ("remote_1=vpn.example.com"));
+	g_ptr_array_add (env, g_strdup ("dev=tun0"));
+	g_ptr_array_add (env, g_strdup ("tun_mtu=1500"));
+	g_ptr_array_add (env, g_strdup ("ifconfig_local=10.8.0.2"));
+	g_ptr_array_add (env, g_strdup ("ifconfig_netmask=255.255.0.0"));
+	g_ptr_array_add (env, g_strdup ("route_vpn_gateway=10.8.0.1"));
+	g_ptr_array_add (env, g_strdup ("ifconfig_ipv6_local=fd00::2"));
+	g_ptr_array_add (env, g_strdup ("ifconfig_ipv6_netbits=64"));
+
+	for (i = 1; i <= n; i++) {
+		g_ptr_array_add (env, g_strdup_printf ("route_network_%u=10.%u.%u.0",
+		                                       i, (i >> 8) & 0xFF, i & 0xFF));
+		g_ptr_array_add (env, g_strdup_printf ("route_netmask_%u=255.255.255.0", i));
+		g_ptr_array_add (env, g_strdup_printf ("route_gateway_%u=10.8.0.1", i));
+		g_ptr_array_add (env, g_strdup_printf ("route_metric_%u=%u", i, i % 10));
+		g_ptr_array_add (env, g_strdup_printf ("route_ipv6_network_%u=fd01:%x::/48", i, i));
+		g_ptr_array_add (env, g_strdup_printf ("route_ipv6_gateway_%u=fd00::1", i));
+		switch (i % 3) {
+		case 0:
+			g_ptr_array_add (env, g_strdup_printf ("foreign_option_%u=dhcp-option DNS 10.8.%u.%u",
+			                                       i, (i >> 8) & 0xFF, i & 0xFF));
+			break;
+		case 1:
+			g_ptr_array_add (env, g_strdup_printf ("foreign_option_%u=dhcp-option DOMAIN d%u.example.com", i, i));
+			break;
+		default:
+			g_ptr_array_add (env, g_strdup_printf ("foreign_option_%u=dhcp-option WINS 10.9.%u.%u",
+			                                       i, (i >> 8) & 0xFF, i & 0xFF));
+			break;
+		}
+	}
+
+	g_ptr_array_add (env, NULL);
+	return (char **) g_ptr_array_free (env, FALSE);
+}
+
+static void
+_bench (guint n, gboolean aggregate_routes)
+{
+	NMOvpnHelperEnvOptions options = {
+		.tapdev = -1,
+		.aggregate_routes = aggregate_routes,
+	};
+	gs_strfreev char **env = NULL;
+	gs_free char *name = NULL;
+	NMOvpnBench bench;
+	guint i;
+
+	env = _generate_env (n);
+
+	name = g_strdup_printf ("env %5u%s", n, aggregate_routes ? " aggregated" : "");
+	nmovpn_bench_start (&bench, name);
+	for (i = 0; i < N_ITERATIONS; i++) {
+		GVariant *config, *ip4config, *ip6config;
+		GError *error = NULL;
+
+		if (!nmovpn_helper_env_parse (env, &options, &config, &ip4config, &ip6config, &error))
+			g_error ("parsing failed: %s", error->message);
+		g_variant_unref (config);
+		g_variant_unref (ip4config);
+		g_variant_unref (ip6config);
+	}
+	nmovpn_bench_stop_items (&bench, N_ITERATIONS, g_strv_length (env), "var");
+}
+
+int
+main (int argc, char **argv)
+{
+	static const guint default_sizes[] = { 0, 16, 64, 255, 1000, 10000 };
+	int i;
+
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+
+	nmovpn_bench_init ();
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			guint n = g_ascii_strtoull (argv[i], NULL, 10);
+
+			_bench (n, FALSE);
+			_bench (n, TRUE);
+		}
+	} else {
+		for (i = 0; i < (int) G_N_ELEMENTS (default_sizes); i++) {
+			_bench (default_sizes[i], FALSE);
+			_bench (default_sizes[i], TRUE);
+		}
+	}
+
+	nmovpn_bench_print_peak_rss ();
+
+	return 0;
+}
@@ -0,0 +1,168 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Compares encoding the pushed routes with GVariantBuilder, as the helper
+ * used to do, against nmovpn_ip4_routes_to_variant() and
+ * nmovpn_ip6_routes_to_variant().
+ *
+ * Usage: bench-helper-routes [N_ROUTES...]
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+#include <netinet/in.h>
+
+#include "nm-openvpn-helper-routes.h"
+
+#include "bench-utils.h"
+
+/*****************************************************************************/
+
+static GVariant *
+_ip4_routes_to_variant_builder (const NMOvpnIP4Route *routes, gsize n_routes)
+{
+	GVariantBuilder builder;
+	gsize i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aau"));
+	for (i = 0; i < n_routes; i++) {
+		GVariantBuilder array;
+
+		g_variant_builder_init (&array, G_VARIANT_TYPE ("au"));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].network));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].prefix));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].gateway));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].metric));
+		g_variant_builder_add_value (&builder, g_variant_builder_end (&array));
+	}
+	return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+_ip6_routes_to_variant_builder (const NMOvpnIP6Route *routes, gsize n_routes)
+{
+	GVariantBuilder builder;
+	gsize i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ayuayu)"));
+	for (i = 0; i < n_routes; i++) {
+		g_variant_builder_add (&builder, "(@ayu@ayu)",
+		                       g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+		                                                  &routes[i].network, 16, 1),
+		                       routes[i].prefix,
+		                       g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+		                                                  &routes[i].gateway, 16, 1),
+		                       routes[i].metric);
+	}
+	return g_variant_builder_end (&builder);
+}
+
+/*****************************************************************************/
+
+static void
+_bench_ip4 (gsize n_routes)
+{
+	gs_free NMOvpnIP4Route *routes = NULL;
+	gs_free char *name = NULL;
+	NMOvpnBench bench;
+	GVariant *value;
+	gsize i;
+
+	routes = g_new0 (NMOvpnIP4Route, n_routes);
+	for (i = 0; i < n_routes; i++) {
+		routes[i].network = htonl (0x0a000000 + (i << 8));
+		routes[i].prefix = 24;
+		routes[i].gateway = htonl (0x0a080001);
+		routes[i].metric = i % 4;
+	}
+
+	name = g_strdup_printf ("ip4 builder   %"G_GSIZE_FORMAT, n_routes);
+	nmovpn_bench_start (&bench, name);
+	value = g_variant_ref_sink (_ip4_routes_to_variant_builder (routes, n_routes));
+	g_variant_get_data (value);
+	g_variant_unref (value);
+	nmovpn_bench_stop (&bench, 1);
+	g_free (name);
+
+	name = g_strdup_printf ("ip4 serialized %"G_GSIZE_FORMAT, n_routes);
+	nmovpn_bench_start (&bench, name);
+	value = g_variant_ref_sink (nmovpn_ip4_routes_to_variant (routes, n_routes));
+	g_variant_get_data (value);
+	g_variant_unref (value);
+	nmovpn_bench_stop (&bench, 1);
+}
+
+static void
+_bench_ip6 (gsize n_routes)
+{
+	gs_free NMOvpnIP6Route *routes = NULL;
+	gs_free char *name = NULL;
+	NMOvpnBench bench;
+	GVariant *value;
+	gsize i;
+
+	routes = g_new0 (NMOvpnIP6Route, n_routes);
+	for (i = 0; i < n_routes; i++) {
+		routes[i].network.s6_addr[0] = 0x20;
+		routes[i].network.s6_addr[1] = 0x01;
+		routes[i].network.s6_addr[4] = (i >> 8) & 0xFF;
+		routes[i].network.s6_addr[5] = i & 0xFF;
+		routes[i].prefix = 48;
+	}
+
+	name = g_strdup_printf ("ip6 builder   %"G_GSIZE_FORMAT, n_routes);
+	nmovpn_bench_start (&bench, name);
+	value = g_variant_ref_sink (_ip6_routes_to_variant_builder (routes, n_routes));
+	g_variant_get_data (value);
+	g_variant_unref (value);
+	nmovpn_bench_stop (&bench, 1);
+	g_free (name);
+
+	name = g_strdup_printf ("ip6 serialized %"G_GSIZE_FORMAT, n_routes);
+	nmovpn_bench_start (&bench, name);
+	value = g_variant_ref_sink (nmovpn_ip6_routes_to_variant (routes, n_routes));
+	g_variant_get_data (value);
+	g_variant_unref (value);
+	nmovpn_bench_stop (&bench, 1);
+}
+
+int
+main (int argc, char **argv)
+{
+	static const gsize default_sizes[] = { 1000, 10000, 100000 };
+	int i;
+
+	nmovpn_bench_init ();
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			gsize n = g_ascii_strtoull (argv[i], NULL, 10);
+
+			_bench_ip4 (n);
+			_bench_ip6 (n);
+		}
+	} else {
+		for (i = 0; i < (int) G_N_ELEMENTS (default_sizes); i++) {
+			_bench_ip4 (default_sizes[i]);
+			_bench_ip6 (default_sizes[i]);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,265 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* A stand-in for openvpn, for test-service-cycles. It understands the
+ * arguments nm-openvpn-service passes, connects to the management socket
+ * and runs the --up script with a fixed configuration.
+ *
+ * What it does is chosen by the first label of the --remote host:
+ *
+ *   ok.test          ask for the password and connect
+ *   auth-fail.test   ask for the password and reject it
+ *   restart.test     connect, then run the --up script again as on a
+ *                    restart
+ *   exit.test        exit with an error before attaching
+ */
+
+#include "nm-default.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+static volatile sig_atomic_t terminated;
+
+static void
+sigterm_handler (int signo)
+{
+	terminated = 1;
+}
+
+/*****************************************************************************/
+
+static FILE *
+mgt_connect (const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX, };
+	FILE *mgt;
+	int fd;
+
+	fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return NULL;
+
+	g_strlcpy (addr.sun_path, path, sizeof (addr.sun_path));
+	if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+		close (fd);
+		return NULL;
+	}
+
+	mgt = fdopen (fd, "r+");
+	setvbuf (mgt, NULL, _IOLBF, 0);
+	return mgt;
+}
+
+static void
+mgt_send (FILE *mgt, const char *line)
+{
+	fprintf (mgt, "%s\r\n", line);
+	fflush (mgt);
+}
+
+/* Reads the next line from the service, answering everything that isn't
+ * a username or password. Returns %NULL on EOF or termination. */
+static char *
+mgt_read_credential (FILE *mgt)
+{
+	char *line = NULL;
+	size_t line_alloc = 0;
+
+	while (!terminated) {
+		ssize_t len;
+
+		len = getline (&line, &line_alloc, mgt);
+		if (len < 0) {
+			if (errno == EINTR && !terminated) {
+				clearerr (mgt);
+				continue;
+			}
+			break;
+		}
+
+		g_strchomp (line);
+		if (g_str_has_prefix (line, "username ") || g_str_has_prefix (line, "password ")) {
+			mgt_send (mgt, "SUCCESS: 'Auth' entered");
+			return line;
+		}
+		mgt_send (mgt, "SUCCESS: ok");
+	}
+
+	free (line);
+	return NULL;
+}
+
+/* Answers commands until the service goes away or we are terminated. */
+static void
+mgt_wait (FILE *mgt)
+{
+	char *line;
+
+	while ((line = mgt_read_credential (mgt)))
+		free (line);
+}
+
+static gboolean
+run_up (const char *up, const char *mode)
+{
+	gs_strfreev char **argv = NULL;
+	gs_strfreev char **envp = NULL;
+	GPtrArray *args;
+	int argc, i, status;
+	gboolean success;
+
+	if (!g_shell_parse_argv (up, &argc, &argv, NULL))
+		return FALSE;
+
+	args = g_ptr_array_new ();
+	for (i = 0; i < argc; i++)
+		g_ptr_array_add (args, argv[i]);
+	/* cmd tun_dev tun_mtu link_mtu ifconfig_local ifconfig_netmask init|restart */
+	g_ptr_array_add (args, "tun0");
+	g_ptr_array_add (args, "1500");
+	g_ptr_array_add (args, "1560");
+	g_ptr_array_add (args, "10.8.0.2");
+	g_ptr_array_add (args, "255.255.255.0");
+	g_ptr_array_add (args, (char *) mode);
+	g_ptr_array_add (args, NULL);
+
+	envp = g_get_environ ();
+	envp = g_environ_setenv (envp, "script_type", "up", TRUE);
+	envp = g_environ_setenv (envp, "trusted_ip", "192.0.2.1", TRUE);
+	envp = g_environ_setenv (envp, "dev", "tun0", TRUE);
+	envp = g_environ_setenv (envp, "tun_mtu", "1500", TRUE);
+	envp = g_environ_setenv (envp, "ifconfig_local", "10.8.0.2", TRUE);
+	envp = g_environ_setenv (envp, "ifconfig_netmask", "255.255.255.0", TRUE);
+	envp = g_environ_setenv (envp, "route_vpn_gateway", "10.8.0.1", TRUE);
+	envp = g_environ_setenv (envp, "route_network_1", "10.10.0.0", TRUE);
+	envp = g_environ_setenv (envp, "route_netmask_1", "255.255.0.0", TRUE);
+	envp = g_environ_setenv (envp, "foreign_option_1", "dhcp-option DNS 10.8.0.1", TRUE);
+
+	success =    g_spawn_sync (NULL, (char **) args->pdata, envp, 0, NULL, NULL,
+	                           NULL, NULL, &status, NULL)
+	          && WIFEXITED (status)
+	          && WEXITSTATUS (status) == 0;
+
+	g_ptr_array_free (args, TRUE);
+	return success;
+}
+
+/*****************************************************************************/
+
+int
+main (int argc, char **argv)
+{
+	const char *mgt_path = NULL;
+	const char *up = NULL;
+	const char *remote = NULL;
+	gboolean mgt_client = FALSE;
+	gboolean auth_user_pass = FALSE;
+	gs_free char *scenario = NULL;
+	struct sigaction sa = { .sa_handler = sigterm_handler, };
+	FILE *mgt;
+	int i;
+
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+
+	for (i = 1; i < argc; i++) {
+		if (nm_streq (argv[i], "--management") && i + 1 < argc)
+			mgt_path = argv[++i];
+		else if (nm_streq (argv[i], "--management-client"))
+			mgt_client = TRUE;
+		else if (nm_streq (argv[i], "--auth-user-pass"))
+			auth_user_pass = TRUE;
+		else if (nm_streq (argv[i], "--up") && i + 1 < argc)
+			up = argv[++i];
+		else if (nm_streq (argv[i], "--remote") && i + 1 < argc)
+			remote = argv[++i];
+	}
+
+	if (!mgt_path || !mgt_client || !up || !remote) {
+		g_printerr ("fake-openvpn: missing --management, --management-client, --up or --remote\n");
+		return 1;
+	}
+	scenario = g_strndup (remote, strcspn (remote, "."));
+
+	if (nm_streq (scenario, "exit"))
+		return 1;
+
+	/* no SA_RESTART, so that a blocking read returns on SIGTERM. */
+	sigaction (SIGTERM, &sa, NULL);
+	sigaction (SIGINT, &sa, NULL);
+
+	mgt = mgt_connect (mgt_path);
+	if (!mgt) {
+		g_printerr ("fake-openvpn: cannot connect to %s: %s\n", mgt_path, g_strerror (errno));
+		return 1;
+	}
+
+	mgt_send (mgt, ">INFO:OpenVPN Management Interface Version 1 -- type 'help' for more info");
+
+	if (auth_user_pass) {
+		char *line;
+		gboolean have_username = FALSE, have_password = FALSE;
+
+		mgt_send (mgt, ">PASSWORD:Need 'Auth' username/password");
+		while (   !(have_username && have_password)
+		       && (line = mgt_read_credential (mgt))) {
+			if (g_str_has_prefix (line, "username "))
+				have_username = TRUE;
+			else
+				have_password = TRUE;
+			free (line);
+		}
+		if (!have_username || !have_password)
+			return 0;
+
+		if (nm_streq (scenario, "auth-fail")) {
+			mgt_send (mgt, ">PASSWORD:Verification Failed: 'Auth'");
+			mgt_wait (mgt);
+			return 0;
+		}
+	}
+
+	mgt_send (mgt, ">STATE:1,ASSIGN_IP,,10.8.0.2,,,,");
+	if (!run_up (up, "init")) {
+		g_printerr ("fake-openvpn: the up script failed\n");
+		return 1;
+	}
+
+	if (nm_streq (scenario, "restart")) {
+		mgt_send (mgt, ">STATE:2,RECONNECTING,connection-reset,,,,,");
+		if (!run_up (up, "restart")) {
+			g_printerr ("fake-openvpn: the up script failed on restart\n");
+			return 1;
+		}
+	}
+
+	mgt_send (mgt, ">STATE:3,CONNECTED,SUCCESS,10.8.0.2,192.0.2.1,1194,,");
+	mgt_wait (mgt);
+
+	fclose (mgt);
+	return 0;
+}
@@ -0,0 +1,72 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* libFuzzer target for nmovpn_helper_env_parse(), built with
+ * --enable-fuzzing. The input is the environment, one variable per line.
+ * The first byte selects the options.
+ *
+ * Usage: fuzz-helper-env [CORPUS_DIR...]
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+
+#include "nm-openvpn-helper-env.h"
+
+int LLVMFuzzerTestOneInput (const guint8 *data, size_t size);
+
+int
+LLVMFuzzerTestOneInput (const guint8 *data, size_t size)
+{
+	NMOvpnHelperEnvOptions options = { .tapdev = -1, };
+	GVariant *config = NULL, *ip4config = NULL, *ip6config = NULL;
+	gs_free char *str = NULL;
+	gs_strfreev char **env = NULL;
+	GError *error = NULL;
+
+	if (size < 1)
+		return 0;
+
+	/* no resolver, the fuzzer must not go to the network. */
+	options.tapdev = (int) (data[0] % 3) - 1;
+	options.aggregate_routes = !!(data[0] & 0x04);
+	options.is_restart = !!(data[0] & 0x08);
+	options.restart_local = "10.8.0.2";
+	options.restart_remote = "255.255.255.0";
+	options.ip4_routes_digest = (data[0] & 0x10) ? "0" : NULL;
+
+	str = g_strndup ((const char *) &data[1], size - 1);
+	env = g_strsplit (str, "\n", -1);
+
+	if (nmovpn_helper_env_parse (env, &options, &config, &ip4config, &ip6config, &error)) {
+		g_assert (config);
+		g_assert (ip4config || ip6config);
+		g_variant_unref (config);
+		if (ip4config)
+			g_variant_unref (ip4config);
+		if (ip6config)
+			g_variant_unref (ip6config);
+	} else {
+		g_assert (error);
+		g_assert (!config && !ip4config && !ip6config);
+		g_error_free (error);
+	}
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "nm-openvpn-helper-env.h"
+
+#include "nm-utils/nm-test-utils.h"
+
+/*****************************************************************************/
+
+static const NMOvpnHelperEnvOptions default_options = {
+	.tapdev = -1,
+};
+
+static void
+test_env_tun (void)
+{
+	const char *env[] = {
+		"PATH=/usr/bin",
+		"trusted_ip=192.0.2.1",
+		"dev=tun0",
+		"ifconfig_local=10.8.0.2",
+		"ifconfig_netmask=255.255.255.0",
+		"route_vpn_gateway=10.8.0.1",
+		"route_network_1=10.10.0.0",
+		"route_netmask_1=255.255.0.0",
+		"route_network_2=10.20.0.0",
+		"route_netmask_2=255.255.0.0",
+		"route_metric_2=50",
+		"foreign_option_1=dhcp-option DNS 10.8.0.1",
+		"foreign_option_2=dhcp-option DOMAIN example.com",
+		"tun_mtu=1400",
+		NULL,
+	};
+	gs_unref_variant GVariant *config = NULL;
+	gs_unref_variant GVariant *ip4config = NULL;
+	gs_unref_variant GVariant *ip6config = NULL;
+	gs_unref_variant GVariant *routes = NULL;
+	gs_unref_variant GVariant *dns = NULL;
+	gs_free const char **domains = NULL;
+	const char *dev;
+	guint32 u32;
+	GError *error = NULL;
+
+	g_assert (nmovpn_helper_env_parse ((char **) env, &default_options, &config, &ip4config, &ip6config, &error));
+	g_assert_no_error (error);
+	g_assert (config);
+	g_assert (ip4config);
+	g_assert (!ip6config);
+
+	g_assert (g_variant_lookup (config, NM_VPN_PLUGIN_CONFIG_TUNDEV, "&s", &dev));
+	g_assert_cmpstr (dev, ==, "tun0");
+	g_assert (g_variant_lookup (config, NM_VPN_PLUGIN_CONFIG_EXT_GATEWAY, "u", &u32));
+	g_assert_cmpint (u32, ==, inet_addr ("192.0.2.1"));
+	g_assert (g_variant_lookup (config, NM_VPN_PLUGIN_CONFIG_MTU, "u", &u32));
+	g_assert_cmpint (u32, ==, 1400);
+
+	g_assert (g_variant_lookup (ip4config, NM_VPN_PLUGIN_IP4_CONFIG_ADDRESS, "u", &u32));
+	g_assert_cmpint (u32, ==, inet_addr ("10.8.0.2"));
+	g_assert (g_variant_lookup (ip4config, NM_VPN_PLUGIN_IP4_CONFIG_PREFIX, "u", &u32));
+	g_assert_cmpint (u32, ==, 24);
+	g_assert (g_variant_lookup (ip4config, NM_VPN_PLUGIN_IP4_CONFIG_INT_GATEWAY, "u", &u32));
+	g_assert_cmpint (u32, ==, inet_addr ("10.8.0.1"));
+
+	routes = g_variant_lookup_value (ip4config, NM_VPN_PLUGIN_IP4_CONFIG_ROUTES, G_VARIANT_TYPE ("aau"));
+	g_assert (routes);
+	g_assert_cmpint (g_variant_n_children (routes), ==, 2);
+
+	dns = g_variant_lookup_value (ip4config, NM_VPN_PLUGIN_IP4_CONFIG_DNS, G_VARIANT_TYPE ("au"));
+	g_assert (dns);
+	g_assert_cmpint (g_variant_n_children (dns), ==, 1);
+
+	g_assert (g_variant_lookup (ip4config, NM_VPN_PLUGIN_IP4_CONFIG_DOMAINS, "^a&s", &domains));
+	g_assert_cmpstr (domains[0], ==, "example.com");
+	g_assert (!domains[1]);
+}
+
+static void
+test_env_ip6 (void)
+{
+	const char *env[] = {
+		"trusted_ip6=2001:db8::1",
+		"dev=tap0",
+		"ifconfig_ipv6_local=fd00::2",
+		"ifconfig_ipv6_netbits=64",
+		"route_ipv6_network_1=fd01::/48",
+		"route_ipv6_network_2=fd02::",
+		"foreign_option_1=dhcp-option DNS fd00::1",
+		NULL,
+	};
+	gs_unref_variant GVariant *config = NULL;
+	gs_unref_variant GVariant *ip4config = NULL;
+	gs_unref_variant GVariant *ip6config = NULL;
+	gs_unref_variant GVariant *routes = NULL;
+	gs_unref_variant GVariant *dns = NULL;
+	guint32 u32;
+	GError *error = NULL;
+
+	g_assert (nmovpn_helper_env_parse ((char **) env, &default_options, &config, &ip4config, &ip6config, &error));
+	g_assert_no_error (error);
+	g_assert (!ip4config);
+	g_assert (ip6config);
+
+	g_assert (g_variant_lookup (ip6config, NM_VPN_PLUGIN_IP6_CONFIG_PREFIX, "u", &u32));
+	g_assert_cmpint (u32, ==, 64);
+
+	/* the route without prefix length is ignored. */
+	routes = g_variant_lookup_value (ip6config, NM_VPN_PLUGIN_IP6_CONFIG_ROUTES, G_VARIANT_TYPE ("a(ayuayu)"));
+	g_assert (routes);
+	g_assert_cmpint (g_variant_n_children (routes), ==, 1);
+
+	dns = g_variant_lookup_value (ip6config, NM_VPN_PLUGIN_IP6_CONFIG_DNS, G_VARIANT_TYPE ("aay"));
+	g_assert (dns);
+	g_assert_cmpint (g_variant_n_children (dns), ==, 1);
+}
+
+static void
+_assert_env_fails (const char **env, const char *expected)
+{
+	GVariant *config = NULL, *ip4config = NULL, *ip6config = NULL;
+	GError *error = NULL;
+
+	g_assert (!nmovpn_helper_env_parse ((char **) env, &default_options, &config, &ip4config, &ip6config, &error));
+	g_assert_error (error, NM_VPN_PLUGIN_ERROR, NM_VPN_PLUGIN_ERROR_BAD_ARGUMENTS);
+	g_assert_cmpstr (error->message, ==, expected);
+	g_assert (!config);
+	g_assert (!ip4config);
+	g_assert (!ip6config);
+	g_clear_error (&error);
+}
+
+static void
+test_env_failures (void)
+{
+	const char *no_gateway[] = { "dev=tun0", "ifconfig_local=10.8.0.2", NULL };
+	const char *unresolved[] = { "remote_1=vpn.example.com", "dev=tun0", NULL };
+	const char *no_dev[] = { "trusted_ip=192.0.2.1", "ifconfig_local=10.8.0.2", NULL };
+	const char *bad_address[] = { "trusted_ip=192.0.2.1", "dev=tun0", "ifconfig_local=10.8.0", NULL };
+	const char *no_config[] = { "trusted_ip=192.0.2.1", "dev=tun0", NULL };
+
+	_assert_env_fails (no_gateway, "VPN Gateway");
+	_assert_env_fails (unresolved, "VPN Gateway");
+	_assert_env_fails (no_dev, "Tunnel Device");
+	_assert_env_fails (bad_address, "IP4 Address");
+	_assert_env_fails (no_config, "IPv4 or IPv6 configuration");
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int main (int argc, char **argv)
+{
+	nmtst_init (&argc, &argv, TRUE);
+
+	g_test_add_func ("/ovpn/helper/env-tun", test_env_tun);
+	g_test_add_func ("/ovpn/helper/env-ip6", test_env_ip6);
+	g_test_add_func ("/ovpn/helper/env-failures", test_env_failures);
+
+	return g_test_run ();
+}
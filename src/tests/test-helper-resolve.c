@@ -0,0 +1,202 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+
+#include "nm-openvpn-helper-resolve.h"
+
+#include "nm-utils/nm-test-utils.h"
+
+/*****************************************************************************/
+
+/* A resolver that answers from a fixed table, without touching the
+ * network. "hang.example.com" never gets an answer. */
+
+typedef struct {
+	GResolver parent;
+} StubResolver;
+
+typedef struct {
+	GResolverClass parent;
+} StubResolverClass;
+
+GType stub_resolver_get_type (void);
+
+G_DEFINE_TYPE (StubResolver, stub_resolver, G_TYPE_RESOLVER)
+
+static const struct {
+	const char *host;
+	const char *addresses[3];
+} stub_hosts[] = {
+	{ "gw.example.com",   { "2001:db8::1", "192.0.2.1", NULL } },
+	{ "v6.example.com",   { "2001:db8::2", NULL } },
+};
+
+static void
+_stub_cancelled_cb (GCancellable *cancellable, gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+
+	g_simple_async_result_set_error (simple, G_IO_ERROR, G_IO_ERROR_CANCELLED, "cancelled");
+	g_simple_async_result_complete_in_idle (simple);
+}
+
+static void
+stub_lookup_by_name_async (GResolver *resolver,
+                           const char *hostname,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data)
+{
+	GSimpleAsyncResult *simple;
+	GList *addresses = NULL;
+	guint i, j;
+
+	simple = g_simple_async_result_new (G_OBJECT (resolver), callback, user_data,
+	                                    stub_lookup_by_name_async);
+
+	if (nm_streq (hostname, "hang.example.com")) {
+		g_assert (cancellable);
+		g_cancellable_connect (cancellable, G_CALLBACK (_stub_cancelled_cb),
+		                       g_object_ref (simple), g_object_unref);
+		g_object_unref (simple);
+		return;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (stub_hosts); i++) {
+		if (!nm_streq (hostname, stub_hosts[i].host))
+			continue;
+		for (j = 0; stub_hosts[i].addresses[j]; j++) {
+			addresses = g_list_append (addresses,
+			                           g_inet_address_new_from_string (stub_hosts[i].addresses[j]));
+		}
+	}
+
+	if (addresses) {
+		g_simple_async_result_set_op_res_gpointer (simple, addresses,
+		                                           (GDestroyNotify) g_resolver_free_addresses);
+	} else {
+		g_simple_async_result_set_error (simple, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND,
+		                                 "no such host %s", hostname);
+	}
+	g_simple_async_result_complete_in_idle (simple);
+	g_object_unref (simple);
+}
+
+static GList *
+stub_lookup_by_name_finish (GResolver *resolver,
+                            GAsyncResult *result,
+                            GError **error)
+{
+	GSimpleAsyncResult *simple = G_SIMPLE_ASYNC_RESULT (result);
+	GList *addresses, *iter;
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	addresses = g_list_copy (g_simple_async_result_get_op_res_gpointer (simple));
+	for (iter = addresses; iter; iter = iter->next)
+		g_object_ref (iter->data);
+	return addresses;
+}
+
+static void
+stub_resolver_init (StubResolver *resolver)
+{
+}
+
+static void
+stub_resolver_class_init (StubResolverClass *klass)
+{
+	GResolverClass *resolver_class = G_RESOLVER_CLASS (klass);
+
+	resolver_class->lookup_by_name_async = stub_lookup_by_name_async;
+	resolver_class->lookup_by_name_finish = stub_lookup_by_name_finish;
+}
+
+/*****************************************************************************/
+
+static void
+_assert_resolve (const char *host, const char *expected)
+{
+	gs_unref_object GResolver *resolver = g_object_new (stub_resolver_get_type (), NULL);
+	gs_unref_object GInetAddress *addr = NULL;
+	gs_free char *addr_str = NULL;
+	GError *error = NULL;
+
+	addr = nmovpn_resolve_remote (resolver, host, 5000, &error);
+	g_assert_no_error (error);
+	g_assert (addr);
+
+	addr_str = g_inet_address_to_string (addr);
+	g_assert_cmpstr (addr_str, ==, expected);
+}
+
+static void
+test_resolve (void)
+{
+	/* IPv4 is preferred, whatever the order of the answer */
+	_assert_resolve ("gw.example.com", "192.0.2.1");
+	_assert_resolve ("v6.example.com", "2001:db8::2");
+}
+
+static void
+test_resolve_not_found (void)
+{
+	gs_unref_object GResolver *resolver = g_object_new (stub_resolver_get_type (), NULL);
+	GInetAddress *addr;
+	GError *error = NULL;
+
+	addr = nmovpn_resolve_remote (resolver, "nx.example.com", 5000, &error);
+	g_assert_error (error, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND);
+	g_assert (!addr);
+	g_clear_error (&error);
+}
+
+static void
+test_resolve_timeout (void)
+{
+	gs_unref_object GResolver *resolver = g_object_new (stub_resolver_get_type (), NULL);
+	GInetAddress *addr;
+	GError *error = NULL;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+	addr = nmovpn_resolve_remote (resolver, "hang.example.com", 50, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+	g_assert (!addr);
+	g_assert_cmpint (g_get_monotonic_time () - start, <, 5 * G_USEC_PER_SEC);
+	g_clear_error (&error);
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int main (int argc, char **argv)
+{
+	nmtst_init (&argc, &argv, TRUE);
+
+	g_test_add_func ("/ovpn/helper/resolve", test_resolve);
+	g_test_add_func ("/ovpn/helper/resolve-not-found", test_resolve_not_found);
+	g_test_add_func ("/ovpn/helper/resolve-timeout", test_resolve_timeout);
+
+	return g_test_run ();
+}
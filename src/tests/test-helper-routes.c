@@ -0,0 +1,298 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "nm-openvpn-helper-routes.h"
+
+#include "nm-utils/nm-test-utils.h"
+
+/*****************************************************************************/
+
+/* The reference encodings, as the helper used to build them with
+ * GVariantBuilder. */
+
+static GVariant *
+_ip4_routes_to_variant_ref (const NMOvpnIP4Route *routes, gsize n_routes)
+{
+	GVariantBuilder builder;
+	gsize i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aau"));
+	for (i = 0; i < n_routes; i++) {
+		GVariantBuilder array;
+
+		g_variant_builder_init (&array, G_VARIANT_TYPE ("au"));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].network));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].prefix));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].gateway));
+		g_variant_builder_add_value (&array, g_variant_new_uint32 (routes[i].metric));
+		g_variant_builder_add_value (&builder, g_variant_builder_end (&array));
+	}
+	return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+_ip6_routes_to_variant_ref (const NMOvpnIP6Route *routes, gsize n_routes)
+{
+	GVariantBuilder builder;
+	gsize i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ayuayu)"));
+	for (i = 0; i < n_routes; i++) {
+		g_variant_builder_add (&builder, "(@ayu@ayu)",
+		                       g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+		                                                  &routes[i].network, 16, 1),
+		                       routes[i].prefix,
+		                       g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+		                                                  &routes[i].gateway, 16, 1),
+		                       routes[i].metric);
+	}
+	return g_variant_builder_end (&builder);
+}
+
+static void
+_assert_variant_same (GVariant *value, GVariant *expected)
+{
+	g_assert (value);
+	g_assert (g_variant_is_normal_form (value));
+	g_assert_cmpstr (g_variant_get_type_string (value), ==, g_variant_get_type_string (expected));
+	g_assert_cmpuint (g_variant_get_size (value), ==, g_variant_get_size (expected));
+	g_assert (memcmp (g_variant_get_data (value),
+	                  g_variant_get_data (expected),
+	                  g_variant_get_size (value)) == 0);
+	g_assert (g_variant_equal (value, expected));
+}
+
+/*****************************************************************************/
+
+static void
+test_ip4_routes (gconstpointer test_data)
+{
+	gsize n_routes = GPOINTER_TO_SIZE (test_data);
+	gs_free NMOvpnIP4Route *routes = NULL;
+	gs_unref_variant GVariant *value = NULL;
+	gs_unref_variant GVariant *expected = NULL;
+	gsize i;
+
+	routes = g_new0 (NMOvpnIP4Route, n_routes + 1);
+	for (i = 0; i < n_routes; i++) {
+		routes[i].network = nmtst_get_rand_int ();
+		routes[i].prefix = g_rand_int_range (nmtst_get_rand (), 1, 33);
+		routes[i].gateway = (i % 3) ? nmtst_get_rand_int () : 0;
+		routes[i].metric = (i % 5) ? nmtst_get_rand_int () : 0;
+	}
+
+	value = g_variant_ref_sink (nmovpn_ip4_routes_to_variant (routes, n_routes));
+	expected = g_variant_ref_sink (_ip4_routes_to_variant_ref (routes, n_routes));
+	_assert_variant_same (value, expected);
+
+	if (n_routes) {
+		guint32 network, prefix, gateway, metric;
+		GVariant *route;
+
+		route = g_variant_get_child_value (value, n_routes - 1);
+		g_assert_cmpuint (g_variant_n_children (route), ==, 4);
+		g_variant_get_child (route, 0, "u", &network);
+		g_variant_get_child (route, 1, "u", &prefix);
+		g_variant_get_child (route, 2, "u", &gateway);
+		g_variant_get_child (route, 3, "u", &metric);
+		g_assert_cmpuint (network, ==, routes[n_routes - 1].network);
+		g_assert_cmpuint (prefix, ==, routes[n_routes - 1].prefix);
+		g_assert_cmpuint (gateway, ==, routes[n_routes - 1].gateway);
+		g_assert_cmpuint (metric, ==, routes[n_routes - 1].metric);
+		g_variant_unref (route);
+	}
+}
+
+static void
+test_ip6_routes (gconstpointer test_data)
+{
+	gsize n_routes = GPOINTER_TO_SIZE (test_data);
+	gs_free NMOvpnIP6Route *routes = NULL;
+	gs_unref_variant GVariant *value = NULL;
+	gs_unref_variant GVariant *expected = NULL;
+	gsize i;
+
+	routes = g_new0 (NMOvpnIP6Route, n_routes + 1);
+	for (i = 0; i < n_routes; i++) {
+		nmtst_rand_buf (NULL, &routes[i].network, sizeof (routes[i].network));
+		routes[i].prefix = g_rand_int_range (nmtst_get_rand (), 1, 129);
+		if (i % 3)
+			nmtst_rand_buf (NULL, &routes[i].gateway, sizeof (routes[i].gateway));
+		routes[i].metric = (i % 5) ? nmtst_get_rand_int () : 0;
+	}
+
+	value = g_variant_ref_sink (nmovpn_ip6_routes_to_variant (routes, n_routes));
+	expected = g_variant_ref_sink (_ip6_routes_to_variant_ref (routes, n_routes));
+	_assert_variant_same (value, expected);
+
+	if (n_routes) {
+		gs_unref_variant GVariant *network = NULL;
+		gs_unref_variant GVariant *gateway = NULL;
+		guint32 prefix, metric;
+		gsize len;
+
+		g_variant_get_child (value, n_routes - 1, "(@ayu@ayu)",
+		                     &network, &prefix, &gateway, &metric);
+		g_assert (memcmp (g_variant_get_fixed_array (network, &len, 1),
+		                  &routes[n_routes - 1].network, 16) == 0);
+		g_assert_cmpuint (len, ==, 16);
+		g_assert (memcmp (g_variant_get_fixed_array (gateway, &len, 1),
+		                  &routes[n_routes - 1].gateway, 16) == 0);
+		g_assert_cmpuint (len, ==, 16);
+		g_assert_cmpuint (prefix, ==, routes[n_routes - 1].prefix);
+		g_assert_cmpuint (metric, ==, routes[n_routes - 1].metric);
+	}
+}
+
+/*****************************************************************************/
+
+#define IP4_ROUTE(net, plen, gw, m) \
+	{ .network = nmtst_inet4_from_string (net), .prefix = (plen), .gateway = nmtst_inet4_from_string (gw), .metric = (m), }
+
+static void
+_assert_ip4_routes (const NMOvpnIP4Route *routes, gsize n_routes,
+                    const NMOvpnIP4Route *expected, gsize n_expected)
+{
+	gsize i, j;
+
+	/* the order of the aggregated routes is not defined */
+	g_assert_cmpuint (n_routes, ==, n_expected);
+	for (i = 0; i < n_expected; i++) {
+		for (j = 0; j < n_routes; j++) {
+			if (memcmp (&routes[j], &expected[i], sizeof (NMOvpnIP4Route)) == 0)
+				break;
+		}
+		g_assert_cmpuint (j, <, n_routes);
+	}
+}
+
+static void
+test_ip4_routes_aggregate (void)
+{
+	gsize n, i;
+
+	{
+		/* siblings merge up to the covering prefix; a contained route goes away */
+		NMOvpnIP4Route routes[17];
+		const NMOvpnIP4Route expected[] = {
+			IP4_ROUTE ("10.0.0.0", 20, "10.8.0.1", 0),
+		};
+
+		for (i = 0; i < 16; i++) {
+			routes[i].network = htonl (0x0a000000 + ((15 - i) << 8));
+			routes[i].prefix = 24;
+			routes[i].gateway = nmtst_inet4_from_string ("10.8.0.1");
+			routes[i].metric = 0;
+		}
+		routes[16] = (NMOvpnIP4Route) IP4_ROUTE ("10.0.5.128", 25, "10.8.0.1", 0);
+
+		n = nmovpn_ip4_routes_aggregate (routes, G_N_ELEMENTS (routes));
+		_assert_ip4_routes (routes, n, expected, G_N_ELEMENTS (expected));
+	}
+	{
+		/* different gateway, metric or a missing sibling prevent merging;
+		 * duplicates are dropped. */
+		NMOvpnIP4Route routes[] = {
+			IP4_ROUTE ("192.168.0.0", 24, "10.8.0.1", 0),
+			IP4_ROUTE ("192.168.1.0", 24, "10.8.0.2", 0),
+			IP4_ROUTE ("192.168.2.0", 24, "10.8.0.1", 0),
+			IP4_ROUTE ("192.168.3.0", 24, "10.8.0.1", 10),
+			IP4_ROUTE ("192.168.4.0", 24, NULL, 0),
+			IP4_ROUTE ("192.168.4.0", 24, NULL, 0),
+			IP4_ROUTE ("192.168.4.1", 32, "10.8.0.1", 0),
+		};
+		const NMOvpnIP4Route expected[] = {
+			IP4_ROUTE ("192.168.0.0", 24, "10.8.0.1", 0),
+			IP4_ROUTE ("192.168.1.0", 24, "10.8.0.2", 0),
+			IP4_ROUTE ("192.168.2.0", 24, "10.8.0.1", 0),
+			IP4_ROUTE ("192.168.3.0", 24, "10.8.0.1", 10),
+			IP4_ROUTE ("192.168.4.0", 24, NULL, 0),
+			IP4_ROUTE ("192.168.4.1", 32, "10.8.0.1", 0),
+		};
+
+		n = nmovpn_ip4_routes_aggregate (routes, G_N_ELEMENTS (routes));
+		_assert_ip4_routes (routes, n, expected, G_N_ELEMENTS (expected));
+	}
+	{
+		/* "def1" must stay two routes */
+		NMOvpnIP4Route routes[] = {
+			IP4_ROUTE ("128.0.0.0", 1, "10.8.0.1", 0),
+			IP4_ROUTE ("0.0.0.0", 1, "10.8.0.1", 0),
+		};
+		const NMOvpnIP4Route expected[] = {
+			IP4_ROUTE ("0.0.0.0", 1, "10.8.0.1", 0),
+			IP4_ROUTE ("128.0.0.0", 1, "10.8.0.1", 0),
+		};
+
+		n = nmovpn_ip4_routes_aggregate (routes, G_N_ELEMENTS (routes));
+		_assert_ip4_routes (routes, n, expected, G_N_ELEMENTS (expected));
+	}
+}
+
+static void
+test_ip6_routes_aggregate (void)
+{
+	NMOvpnIP6Route routes[3];
+	gsize n;
+
+	memset (routes, 0, sizeof (routes));
+	routes[0].network = *nmtst_inet6_from_string ("2001:db8::");
+	routes[0].prefix = 48;
+	routes[1].network = *nmtst_inet6_from_string ("2001:db8:1::");
+	routes[1].prefix = 48;
+	routes[2].network = *nmtst_inet6_from_string ("2001:db8:1:2::");
+	routes[2].prefix = 64;
+
+	n = nmovpn_ip6_routes_aggregate (routes, G_N_ELEMENTS (routes));
+	g_assert_cmpuint (n, ==, 1);
+	nmtst_assert_ip6_address (&routes[0].network, "2001:db8::");
+	g_assert_cmpuint (routes[0].prefix, ==, 47);
+	nmtst_assert_ip6_address (&routes[0].gateway, "::");
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int main (int argc, char **argv)
+{
+	/* the sizes are chosen to cover framing offsets of 1, 2 and 4 bytes. */
+	static const gsize sizes[] = { 0, 1, 2, 5, 15, 16, 100, 1000, 5000, 20000 };
+	guint i;
+
+	nmtst_init (&argc, &argv, TRUE);
+
+	for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+		gs_free char *path4 = g_strdup_printf ("/ovpn/helper/ip4-routes/%"G_GSIZE_FORMAT, sizes[i]);
+		gs_free char *path6 = g_strdup_printf ("/ovpn/helper/ip6-routes/%"G_GSIZE_FORMAT, sizes[i]);
+
+		g_test_add_data_func (path4, GSIZE_TO_POINTER (sizes[i]), test_ip4_routes);
+		g_test_add_data_func (path6, GSIZE_TO_POINTER (sizes[i]), test_ip6_routes);
+	}
+
+	g_test_add_func ("/ovpn/helper/ip4-routes-aggregate", test_ip4_routes_aggregate);
+	g_test_add_func ("/ovpn/helper/ip6-routes-aggregate", test_ip6_routes_aggregate);
+
+	return g_test_run ();
+}
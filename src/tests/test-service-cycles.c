@@ -0,0 +1,430 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Drives nm-openvpn-service end-to-end, without openvpn and without
+ * NetworkManager. A private dbus-daemon stands in for the system bus, and
+ * fake-openvpn for openvpn. We play NetworkManager: connect and disconnect
+ * over and over, cycling through the scenarios of fake-openvpn, and time
+ * both.
+ *
+ * At the end, the service must exit cleanly. It fails if it leaked the
+ * state of any management socket.
+ *
+ * Usage: test-service-cycles [N_CYCLES]
+ *
+ * Skipped if dbus-daemon is not installed.
+ */
+
+#include "nm-default.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "nm-service-defines.h"
+
+#define BUS_NAME          NM_DBUS_SERVICE_OPENVPN ".test"
+#define TIMEOUT_MSEC      10000
+#define DEFAULT_N_CYCLES  20
+
+/*****************************************************************************/
+
+typedef enum {
+	SCENARIO_OK,
+	SCENARIO_AUTH_FAIL,
+	SCENARIO_RESTART,
+	SCENARIO_EXIT,
+	_SCENARIO_NUM,
+} Scenario;
+
+static const char *scenario_remote[_SCENARIO_NUM] = {
+	[SCENARIO_OK]        = "ok.test",
+	[SCENARIO_AUTH_FAIL] = "auth-fail.test",
+	[SCENARIO_RESTART]   = "restart.test",
+	[SCENARIO_EXIT]      = "exit.test",
+};
+
+typedef struct {
+	GDBusConnection *bus;
+	guint state;
+	guint n_ip4_configs;
+	guint n_failures;
+} Harness;
+
+typedef struct {
+	GArray *connect_usec;
+	GArray *disconnect_usec;
+} Latencies;
+
+/*****************************************************************************/
+
+static void
+_signal_cb (GDBusConnection *connection,
+            const char *sender_name,
+            const char *object_path,
+            const char *interface_name,
+            const char *signal_name,
+            GVariant *parameters,
+            gpointer user_data)
+{
+	Harness *h = user_data;
+
+	if (nm_streq (signal_name, "StateChanged"))
+		g_variant_get (parameters, "(u)", &h->state);
+	else if (nm_streq (signal_name, "Ip4Config"))
+		h->n_ip4_configs++;
+	else if (nm_streq (signal_name, "Failure"))
+		h->n_failures++;
+}
+
+static gboolean
+_timeout_cb (gpointer user_data)
+{
+	*((gboolean *) user_data) = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+#define wait_for(cond) \
+	G_STMT_START { \
+		gboolean _timed_out = FALSE; \
+		guint _id = g_timeout_add (TIMEOUT_MSEC, _timeout_cb, &_timed_out); \
+		\
+		while (!(cond) && !_timed_out) \
+			g_main_context_iteration (NULL, TRUE); \
+		if (_timed_out) \
+			g_error ("timed out waiting for %s", #cond); \
+		g_source_remove (_id); \
+	} G_STMT_END
+
+static GVariant *
+_connection_new (Scenario scenario)
+{
+	gs_unref_object NMConnection *connection = NULL;
+	NMSettingConnection *s_con;
+	NMSettingVpn *s_vpn;
+	gs_free char *uuid = NULL;
+
+	connection = nm_simple_connection_new ();
+
+	s_con = (NMSettingConnection *) nm_setting_connection_new ();
+	uuid = nm_utils_uuid_generate ();
+	g_object_set (s_con,
+	              NM_SETTING_CONNECTION_ID, "test-service-cycles",
+	              NM_SETTING_CONNECTION_UUID, uuid,
+	              NM_SETTING_CONNECTION_TYPE, NM_SETTING_VPN_SETTING_NAME,
+	              NULL);
+	nm_connection_add_setting (connection, NM_SETTING (s_con));
+
+	s_vpn = (NMSettingVpn *) nm_setting_vpn_new ();
+	g_object_set (s_vpn, NM_SETTING_VPN_SERVICE_TYPE, NM_VPN_SERVICE_TYPE_OPENVPN, NULL);
+	nm_setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_CONNECTION_TYPE, NM_OPENVPN_CONTYPE_PASSWORD);
+	nm_setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_REMOTE, scenario_remote[scenario]);
+	nm_setting_vpn_add_data_item (s_vpn, NM_OPENVPN_KEY_USERNAME, "user");
+	nm_setting_vpn_add_secret (s_vpn, NM_OPENVPN_KEY_PASSWORD, "secret");
+	nm_connection_add_setting (connection, NM_SETTING (s_vpn));
+
+	return nm_connection_to_dbus (connection, NM_CONNECTION_SERIALIZE_ALL);
+}
+
+static GVariant *
+_call (Harness *h, const char *method, GVariant *parameters, GError **error)
+{
+	return g_dbus_connection_call_sync (h->bus,
+	                                    BUS_NAME,
+	                                    NM_VPN_DBUS_PLUGIN_PATH,
+	                                    NM_VPN_DBUS_PLUGIN_INTERFACE,
+	                                    method,
+	                                    parameters,
+	                                    NULL,
+	                                    G_DBUS_CALL_FLAGS_NONE,
+	                                    TIMEOUT_MSEC,
+	                                    NULL,
+	                                    error);
+}
+
+static void
+_cycle (Harness *h, Scenario scenario, Latencies *latencies)
+{
+	gs_unref_variant GVariant *ret = NULL;
+	GVariant *connection;
+	GError *error = NULL;
+	gint64 start, usec;
+
+	h->n_ip4_configs = 0;
+	h->n_failures = 0;
+
+	connection = _connection_new (scenario);
+
+	start = g_get_monotonic_time ();
+	ret = _call (h, "Connect", g_variant_new ("(@a{sa{sv}})", connection), &error);
+	g_assert_no_error (error);
+
+	switch (scenario) {
+	case SCENARIO_OK:
+	case SCENARIO_RESTART:
+		wait_for (   h->state == NM_VPN_SERVICE_STATE_STARTED
+		          && h->n_ip4_configs == (scenario == SCENARIO_RESTART ? 2 : 1));
+		usec = g_get_monotonic_time () - start;
+		g_array_append_val (latencies->connect_usec, usec);
+
+		g_clear_pointer (&ret, g_variant_unref);
+		start = g_get_monotonic_time ();
+		ret = _call (h, "Disconnect", NULL, &error);
+		g_assert_no_error (error);
+		wait_for (h->state == NM_VPN_SERVICE_STATE_STOPPED);
+		usec = g_get_monotonic_time () - start;
+		g_array_append_val (latencies->disconnect_usec, usec);
+		g_assert_cmpint (h->n_failures, ==, 0);
+		break;
+	case SCENARIO_AUTH_FAIL:
+	case SCENARIO_EXIT:
+		wait_for (h->n_failures > 0 && h->state == NM_VPN_SERVICE_STATE_STOPPED);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+static int
+_cmp_int64 (gconstpointer a, gconstpointer b)
+{
+	gint64 va = *((const gint64 *) a);
+	gint64 vb = *((const gint64 *) b);
+
+	return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+static void
+_print_latencies (const char *what, GArray *values)
+{
+	gint64 sum = 0;
+	guint i;
+
+	if (!values->len)
+		return;
+
+	g_array_sort (values, _cmp_int64);
+	for (i = 0; i < values->len; i++)
+		sum += g_array_index (values, gint64, i);
+
+	g_print ("%-10s n=%-5u min %8.3f ms  avg %8.3f ms  p95 %8.3f ms  max %8.3f ms\n",
+	         what, values->len,
+	         g_array_index (values, gint64, 0) / 1000.0,
+	         sum / 1000.0 / values->len,
+	         g_array_index (values, gint64, (values->len * 95) / 100) / 1000.0,
+	         g_array_index (values, gint64, values->len - 1) / 1000.0);
+}
+
+/*****************************************************************************/
+
+static GPid
+_spawn (char **argv, char **envp)
+{
+	GError *error = NULL;
+	GPid pid;
+	GSpawnFlags flags = G_SPAWN_DO_NOT_REAP_CHILD;
+
+	if (!g_getenv ("NMTST_DEBUG"))
+		flags |= G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL;
+
+	if (!g_spawn_async (NULL, argv, envp, flags, NULL, NULL, &pid, &error))
+		g_error ("cannot spawn %s: %s", argv[0], error->message);
+	return pid;
+}
+
+static int
+_wait_pid (GPid pid)
+{
+	int status;
+
+	while (waitpid (pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			g_error ("waitpid failed: %s", g_strerror (errno));
+	}
+	return status;
+}
+
+static GDBusConnection *
+_bus_connect (const char *address)
+{
+	GDBusConnection *bus = NULL;
+	GError *error = NULL;
+	gint64 deadline;
+
+	/* dbus-daemon needs a moment until it listens. */
+	deadline = g_get_monotonic_time () + TIMEOUT_MSEC * 1000;
+	while (!bus) {
+		bus = g_dbus_connection_new_for_address_sync (address,
+		                                              G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+		                                              | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+		                                              NULL, NULL, &error);
+		if (!bus) {
+			if (g_get_monotonic_time () > deadline)
+				g_error ("cannot connect to the bus: %s", error->message);
+			g_clear_error (&error);
+			g_usleep (10000);
+		}
+	}
+	return bus;
+}
+
+static void
+_wait_for_name (Harness *h)
+{
+	gint64 deadline = g_get_monotonic_time () + TIMEOUT_MSEC * 1000;
+
+	while (TRUE) {
+		gs_unref_variant GVariant *ret = NULL;
+		gboolean has_owner = FALSE;
+
+		ret = g_dbus_connection_call_sync (h->bus,
+		                                   "org.freedesktop.DBus",
+		                                   "/org/freedesktop/DBus",
+		                                   "org.freedesktop.DBus",
+		                                   "NameHasOwner",
+		                                   g_variant_new ("(s)", BUS_NAME),
+		                                   G_VARIANT_TYPE ("(b)"),
+		                                   G_DBUS_CALL_FLAGS_NONE, -1,
+		                                   NULL, NULL);
+		if (ret)
+			g_variant_get (ret, "(b)", &has_owner);
+		if (has_owner)
+			return;
+		if (g_get_monotonic_time () > deadline)
+			g_error ("the service did not appear on the bus");
+		g_usleep (10000);
+	}
+}
+
+static const char *bus_config =
+	"<!DOCTYPE busconfig PUBLIC \"-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN\"\n"
+	" \"http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd\">\n"
+	"<busconfig>\n"
+	"  <type>system</type>\n"
+	"  <listen>unix:path=%s</listen>\n"
+	"  <auth>EXTERNAL</auth>\n"
+	"  <policy context=\"default\">\n"
+	"    <allow own=\"*\"/>\n"
+	"    <allow send_destination=\"*\"/>\n"
+	"    <allow receive_sender=\"*\"/>\n"
+	"  </policy>\n"
+	"</busconfig>\n";
+
+int
+main (int argc, char **argv)
+{
+	gs_free char *dbus_daemon = NULL;
+	gs_free char *tmpdir = NULL;
+	gs_free char *socket_path = NULL;
+	gs_free char *config_path = NULL;
+	gs_free char *config_arg = NULL;
+	gs_free char *config = NULL;
+	gs_free char *address = NULL;
+	gs_strfreev char **envp = NULL;
+	Harness h = { 0 };
+	Latencies latencies;
+	GError *error = NULL;
+	GPid dbus_pid, service_pid;
+	guint n_cycles = DEFAULT_N_CYCLES;
+	guint i;
+	int status;
+
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+
+	if (argc > 1)
+		n_cycles = g_ascii_strtoull (argv[1], NULL, 10);
+
+	dbus_daemon = g_find_program_in_path ("dbus-daemon");
+	if (!dbus_daemon) {
+		g_print ("SKIP: dbus-daemon not found\n");
+		return 77;
+	}
+
+	tmpdir = g_dir_make_tmp ("test-service-cycles-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	socket_path = g_build_filename (tmpdir, "bus", NULL);
+	config_path = g_build_filename (tmpdir, "bus.conf", NULL);
+	config = g_strdup_printf (bus_config, socket_path);
+	g_assert (g_file_set_contents (config_path, config, -1, NULL));
+	config_arg = g_strdup_printf ("--config-file=%s", config_path);
+	address = g_strdup_printf ("unix:path=%s", socket_path);
+
+	{
+		char *dbus_argv[] = { dbus_daemon, config_arg, "--nofork", "--nopidfile", NULL };
+
+		dbus_pid = _spawn (dbus_argv, NULL);
+	}
+	h.bus = _bus_connect (address);
+
+	envp = g_get_environ ();
+	envp = g_environ_setenv (envp, "DBUS_SYSTEM_BUS_ADDRESS", address, TRUE);
+	envp = g_environ_setenv (envp, "NM_OPENVPN_BINARY", TEST_BUILDDIR"/fake-openvpn", TRUE);
+	envp = g_environ_setenv (envp, "NM_OPENVPN_HELPER", TEST_BUILDDIR"/../nm-openvpn-service-openvpn-helper", TRUE);
+	envp = g_environ_setenv (envp, "NM_OPENVPN_RUNDIR", tmpdir, TRUE);
+	envp = g_environ_setenv (envp, "NM_OPENVPN_USER", "", TRUE);
+	envp = g_environ_setenv (envp, "NM_OPENVPN_GROUP", "", TRUE);
+	envp = g_environ_setenv (envp, "NM_OPENVPN_CHROOT", "", TRUE);
+	envp = g_environ_setenv (envp, "NM_OPENVPN_CHECK_LEAKS", "1", TRUE);
+
+	{
+		char *service_argv[] = { TEST_BUILDDIR"/../nm-openvpn-service",
+		                         "--persist", "--bus-name", BUS_NAME, NULL };
+
+		service_pid = _spawn (service_argv, envp);
+	}
+
+	g_dbus_connection_signal_subscribe (h.bus, NULL,
+	                                    NM_VPN_DBUS_PLUGIN_INTERFACE, NULL,
+	                                    NM_VPN_DBUS_PLUGIN_PATH, NULL,
+	                                    G_DBUS_SIGNAL_FLAGS_NONE,
+	                                    _signal_cb, &h, NULL);
+	_wait_for_name (&h);
+
+	latencies.connect_usec = g_array_new (FALSE, FALSE, sizeof (gint64));
+	latencies.disconnect_usec = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+	for (i = 0; i < n_cycles; i++)
+		_cycle (&h, i % _SCENARIO_NUM, &latencies);
+
+	_print_latencies ("connect", latencies.connect_usec);
+	_print_latencies ("disconnect", latencies.disconnect_usec);
+	g_array_unref (latencies.connect_usec);
+	g_array_unref (latencies.disconnect_usec);
+
+	/* the service exits with failure if it leaked anything we track. */
+	kill (service_pid, SIGTERM);
+	status = _wait_pid (service_pid);
+	g_assert (WIFEXITED (status));
+	g_assert_cmpint (WEXITSTATUS (status), ==, EXIT_SUCCESS);
+
+	g_object_unref (h.bus);
+	kill (dbus_pid, SIGTERM);
+	_wait_pid (dbus_pid);
+
+	unlink (socket_path);
+	unlink (config_path);
+	rmdir (tmpdir);
+
+	return 0;
+}